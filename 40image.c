@@ -9,34 +9,169 @@
 #include <stdio.h>
 #include "assert.h"
 #include "compress40.h"
+#include "options.h"
+#include "region.h"
+#include "batch.h"
 
 static void (*compress_or_decompress)(FILE *input) = compress40;
 
-/* Option -c for compression, -d for decompression. Can read from stdin or 
-    file */
+/* List and output directory given to --batch and --out-dir */
+static char *batch_list, *out_dir;
+
+/* Rectangle given to --crop, as x, y, width and height */
+static unsigned crop[4];
+
+/* Decompresses just the rectangle given to --crop */
+static void decompress_crop(FILE *input)
+{
+        decompress40_region(input, crop[0], crop[1], crop[2], crop[3]);
+}
+
+/* Converts every file named in the --batch list into the --out-dir
+    directory, with -j N worker processes instead of N threads per image.
+    Returns the exit status for main. */
+static int run_batch(char *program)
+{
+        FILE *list = fopen(batch_list, "r");
+        if (list == NULL) {
+                fprintf(stderr, "%s: cannot open '%s'\n", program, 
+                        batch_list);
+                return EXIT_FAILURE;
+        }
+
+        const char *suffix = compress_or_decompress == compress40 ? 
+                ".c40" : ".ppm";
+        unsigned failed = batch40(list, out_dir, compress_or_decompress,
+                suffix, compress40_options.threads);
+        fclose(list);
+
+        if (failed > 0) {
+                fprintf(stderr, "%s: %u file%s failed\n", program, failed,
+                        failed == 1 ? "" : "s");
+                return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+}
+
+/* Prints the usage message and exits */
+static void usage(char *program)
+{
+        fprintf(stderr, "Usage: %s -d [-j N] [--fixed] "
+                "[--crop x,y,w,h | --thumbnail] [filename]\n"
+                "       %s -c [-j N] [--fixed] "
+                "[--format 2|3 [--predict]] [filename]\n"
+                "       %s -c|-d [options] --batch list "
+                "--out-dir DIR\n",
+                program, program, program);
+        exit(1);
+}
+
+/* Option -c for compression, -d for decompression, -j N to compress or
+    decompress on N threads, --fixed to use integer arithmetic only,
+    -d --crop x,y,w,h to decompress only a rectangle, -d --thumbnail to
+    decompress at half size, -c --format 3 to write entropy coded tiles
+    instead of plain codewords (format 2), -c --format 3 --predict to code
+    a, Pb and Pr of those tiles as residuals from neighbouring blocks,
+    --batch list --out-dir DIR to convert every file named in list into DIR
+    on N worker processes. Can read from stdin or file */
 int main(int argc, char *argv[])
 {
         int i;
 
+        /* Flags are only recorded here, so their order does not matter.
+            -c and -d are -1 until given, and the last one given wins */
+        int compressing = -1, cropping = 0, thumbnail = 0;
+
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-c") == 0) {
-                        compress_or_decompress = compress40;
+                        compressing = 1;
                 } else if (strcmp(argv[i], "-d") == 0) {
-                        compress_or_decompress = decompress40;
+                        compressing = 0;
+                } else if (strcmp(argv[i], "--crop") == 0 && i + 1 < argc) {
+                        char end;
+                        if (sscanf(argv[++i], "%u,%u,%u,%u%c", &crop[0], 
+                                   &crop[1], &crop[2], &crop[3], &end) != 4
+                            || crop[2] == 0 || crop[3] == 0) {
+                                fprintf(stderr, "%s: bad crop '%s'\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                        cropping = 1;
+                } else if (strcmp(argv[i], "--thumbnail") == 0) {
+                        thumbnail = 1;
+                } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                        char *end;
+                        long threads = strtol(argv[++i], &end, 10);
+                        if (*end != '\0' || threads < 1 || threads > 1024) {
+                                fprintf(stderr, "%s: bad thread count '%s'\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                        compress40_options.threads = threads;
+                } else if (strcmp(argv[i], "--fixed") == 0) {
+                        compress40_options.fixed_point = 1;
+                } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+                        i++;
+                        if (strcmp(argv[i], "2") != 0 && 
+                            strcmp(argv[i], "3") != 0) {
+                                fprintf(stderr, "%s: bad format '%s'\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                        compress40_options.format = atoi(argv[i]);
+                } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+                        batch_list = argv[++i];
+                } else if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) {
+                        out_dir = argv[++i];
+                } else if (strcmp(argv[i], "--predict") == 0) {
+                        compress40_options.predictor = MED_PREDICTOR;
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
                 } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
-                                argv[0], argv[0]);
-                        exit(1);
+                        usage(argv[0]);
                 } else {
                         break;
                 }
         }
         assert(argc - i <= 1);    /* at most one file on command line */
+        if ((cropping || thumbnail) && compressing == 1) {
+                fprintf(stderr, "%s: --%s only works with -d\n", argv[0],
+                        cropping ? "crop" : "thumbnail");
+                usage(argv[0]);
+        }
+        if (cropping && thumbnail) {
+                fprintf(stderr, "%s: --crop and --thumbnail cannot be used "
+                        "together\n", argv[0]);
+                usage(argv[0]);
+        }
+
+        if (cropping) {
+                compress_or_decompress = decompress_crop;
+        } else if (thumbnail) {
+                compress_or_decompress = decompress40_thumbnail;
+        } else if (compressing == 0) {
+                compress_or_decompress = decompress40;
+        }
+
+        if (compress40_options.predictor != NO_PREDICTOR && 
+            compress40_options.format != TILED_FORMAT) {
+                fprintf(stderr, "%s: --predict needs --format 3\n", argv[0]);
+                exit(1);
+        }
+        if ((batch_list == NULL) != (out_dir == NULL) || 
+            (batch_list != NULL && i < argc)) {
+                fprintf(stderr, "%s: --batch needs --out-dir and no "
+                        "filename\n", argv[0]);
+                exit(1);
+        }
+
+        if (batch_list != NULL) {
+                return run_batch(argv[0]);
+        }
+
         if (i < argc) {
                 FILE *fp = fopen(argv[i], "r");
                 assert(fp != NULL);
@@ -46,5 +181,6 @@ int main(int argc, char *argv[])
                 compress_or_decompress(stdin);
         }
 
+        compress40_release();
         return EXIT_SUCCESS; 
 }
@@ -0,0 +1,415 @@
+/*
+   40imaged.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Daemon that compresses and decompresses images for clients over
+        a Unix domain socket, so that a job costs no process start. See
+        imaged.h for the protocol.
+
+        Worker processes are started up front and each one accepts
+        connections on the shared socket, so the socket's listen backlog
+        is the queue of waiting clients. Workers keep compress40's buffers
+        and their inline input buffer from one job to the next. Errors are
+        failed assertions, which end the worker; the daemon then starts a
+        new one and the client sees its connection closed.
+*/
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "assert.h"
+#include "compress40.h"
+#include "options.h"
+#include "chroma.h"
+#include "imaged.h"
+#include "io.h"
+
+#define DEFAULT_WORKERS 4
+#define MAX_WORKERS 1024
+
+/* Clients that can wait for a worker before connect blocks */
+#define DEFAULT_QUEUE 64
+
+/* Set by SIGTERM and SIGINT to shut the daemon down */
+static volatile sig_atomic_t stopping = 0;
+
+/* Inline input of the current job, kept between jobs */
+static char *inline_input;
+static size_t inline_size;
+
+static void stop(int signal)
+{
+        (void) signal;
+        stopping = 1;
+}
+
+/* Receives the next request on a connection, and any descriptors sent
+    with it into fds. Returns 0 once the client is done or the request is
+    malformed. */
+static int receive_request(int conn, Imaged_Request *request, int *fds,
+                           int *nfds)
+{
+        char control[CMSG_SPACE(IMAGED_MAX_FDS * sizeof(int))];
+        struct iovec iov = { request, sizeof(*request) };
+        struct msghdr message = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = control,
+                .msg_controllen = sizeof(control)
+        };
+
+        *nfds = 0;
+
+        ssize_t n;
+        do {
+                n = recvmsg(conn, &message, MSG_CMSG_CLOEXEC);
+        } while (n < 0 && errno == EINTR);
+
+        if (n <= 0) {
+                return 0;
+        }
+
+        struct cmsghdr *cmsg;
+        for (cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&message, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET ||
+                    cmsg->cmsg_type != SCM_RIGHTS) {
+                        continue;
+                }
+
+                int count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                int *passed = (int *) CMSG_DATA(cmsg);
+
+                int i;
+                for (i = 0; i < count; i++) {
+                        if (*nfds < IMAGED_MAX_FDS) {
+                                fds[(*nfds)++] = passed[i];
+                        } else {
+                                close(passed[i]);
+                        }
+                }
+        }
+
+        /* the rest of the request, if it came in pieces */
+        int whole = full_io(conn, (char *) request + n, sizeof(*request) - n,
+                            0);
+
+        return whole && request->magic == IMAGED_MAGIC;
+}
+
+/* Checks a request's job and options, and sets compress40_options from
+    them. Returns 0 or EINVAL. */
+static int set_options(Imaged_Request *request)
+{
+        if (request->job != IMAGED_COMPRESS &&
+            request->job != IMAGED_DECOMPRESS) {
+                return EINVAL;
+        }
+        if (request->format != PLAIN_FORMAT &&
+            request->format != TILED_FORMAT) {
+                return EINVAL;
+        }
+        if (request->predictor != NO_PREDICTOR &&
+            (request->predictor != MED_PREDICTOR ||
+            request->format != TILED_FORMAT)) {
+                return EINVAL;
+        }
+
+        compress40_options.format = request->format;
+        compress40_options.predictor = request->predictor;
+        compress40_options.fixed_point = request->fixed_point != 0;
+
+        return 0;
+}
+
+/* Opens the input of a request: the first descriptor sent with it, or
+    else the inline bytes that follow it. Sets *input, or returns an errno
+    if it cannot. */
+static int open_input(int conn, Imaged_Request *request, int *fds,
+                      int nfds, FILE **input)
+{
+        if (nfds > 0) {
+                *input = fdopen(fds[0], "rb");
+                return *input == NULL ? errno : 0;
+        }
+
+        if (request->length == 0 || request->length > SIZE_MAX - 1) {
+                return EINVAL;
+        }
+
+        if (request->length > inline_size) {
+                free(inline_input);
+                inline_input = malloc(request->length);
+                inline_size = inline_input == NULL ? 0 : request->length;
+                if (inline_input == NULL) {
+                        return ENOMEM;
+                }
+        }
+
+        if (!full_io(conn, inline_input, request->length, 0)) {
+                return EPIPE;
+        }
+
+        *input = fmemopen(inline_input, request->length, "rb");
+        return *input == NULL ? errno : 0;
+}
+
+/* Runs one job, with stdout pointed at output, and sends its reply. The
+    result is sent inline from output unless the client gave an output
+    descriptor. Returns 0 if the connection should be closed. */
+static int run_job(int conn, Imaged_Request *request, FILE *input,
+                   int output, int inline_output, int devnull)
+{
+        fflush(stdout);
+        int redirected = dup2(output, STDOUT_FILENO) >= 0;
+        clearerr(stdout);
+
+        Imaged_Reply reply = { IMAGED_MAGIC, 0, 0 };
+
+        if (redirected) {
+                if (request->job == IMAGED_COMPRESS) {
+                        compress40(input);
+                } else {
+                        decompress40(input);
+                }
+
+                errno = 0;
+                if (fflush(stdout) != 0 || ferror(stdout)) {
+                        reply.error = errno != 0 ? errno : EIO;
+                }
+        } else {
+                reply.error = errno;
+        }
+
+        /* let go of the client's descriptor */
+        dup2(devnull, STDOUT_FILENO);
+
+        off_t length = 0;
+        if (inline_output && reply.error == 0) {
+                length = lseek(output, 0, SEEK_END);
+                if (length < 0) {
+                        reply.error = errno;
+                        length = 0;
+                }
+        }
+        reply.length = length;
+
+        if (!full_io(conn, &reply, sizeof(reply), 1)) {
+                return 0;
+        }
+
+        off_t offset = 0;
+        while (offset < length) {
+                ssize_t n = sendfile(conn, output, &offset, length - offset);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n <= 0) {
+                        return 0;
+                }
+        }
+
+        return 1;
+}
+
+/* Runs every job a client sends on one connection, until it closes */
+static void serve_connection(int conn, int devnull)
+{
+        Imaged_Request request;
+        int fds[IMAGED_MAX_FDS];
+        int nfds;
+
+        while (receive_request(conn, &request, fds, &nfds)) {
+                FILE *input = NULL;
+                int output = nfds > 1 ? fds[1] :
+                        memfd_create("40imaged", MFD_CLOEXEC);
+
+                int error = set_options(&request);
+                if (error == 0 && output < 0) {
+                        error = errno;
+                }
+                if (error == 0) {
+                        error = open_input(conn, &request, fds, nfds,
+                                           &input);
+                }
+
+                int keep = 1;
+                if (error == 0) {
+                        keep = run_job(conn, &request, input, output,
+                                       nfds < 2, devnull);
+                } else {
+                        Imaged_Reply reply = { IMAGED_MAGIC, error, 0 };
+                        keep = full_io(conn, &reply, sizeof(reply), 1);
+                }
+
+                /* fclose closes the input descriptor it was opened on */
+                if (input != NULL) {
+                        fclose(input);
+                } else if (nfds > 0) {
+                        close(fds[0]);
+                }
+                if (output >= 0) {
+                        close(output);
+                }
+
+                /* after an error, inline input may be left unread */
+                if (!keep || error != 0) {
+                        return;
+                }
+        }
+}
+
+/* Body of a worker process: accepts connections forever */
+static void serve(int listener)
+{
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+
+        int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        assert(devnull >= 0);
+
+        /* jobs run in parallel on the workers, not within them */
+        compress40_options.threads = 1;
+
+        for (;;) {
+                int conn = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+                if (conn < 0) {
+                        assert(errno == EINTR || errno == ECONNABORTED);
+                        continue;
+                }
+
+                serve_connection(conn, devnull);
+                close(conn);
+        }
+}
+
+/* Forks a worker. Returns its pid in the daemon. */
+static pid_t start_worker(int listener)
+{
+        fflush(NULL);
+
+        pid_t pid = fork();
+        assert(pid >= 0);
+
+        if (pid == 0) {
+                serve(listener);
+        }
+
+        return pid;
+}
+
+/* Options -j N for N worker processes, -q N to let N clients wait for a
+    worker. Takes the path of the socket to listen on. */
+int main(int argc, char *argv[])
+{
+        long workers = DEFAULT_WORKERS;
+        long queue = DEFAULT_QUEUE;
+        int i;
+
+        for (i = 1; i < argc - 1; i++) {
+                long *value;
+                if (strcmp(argv[i], "-j") == 0) {
+                        value = &workers;
+                } else if (strcmp(argv[i], "-q") == 0) {
+                        value = &queue;
+                } else {
+                        break;
+                }
+
+                char *end;
+                *value = strtol(argv[++i], &end, 10);
+                if (*end != '\0' || *value < 1 || *value > MAX_WORKERS) {
+                        fprintf(stderr, "%s: bad count '%s'\n", argv[0],
+                                argv[i]);
+                        exit(1);
+                }
+        }
+
+        if (i != argc - 1) {
+                fprintf(stderr, "Usage: %s [-j N] [-q N] socket\n", argv[0]);
+                exit(1);
+        }
+
+        struct sockaddr_un address = { .sun_family = AF_UNIX };
+        if (strlen(argv[i]) >= sizeof(address.sun_path)) {
+                fprintf(stderr, "%s: socket path too long\n", argv[0]);
+                exit(1);
+        }
+        strcpy(address.sun_path, argv[i]);
+
+        /* workers share the tables instead of each building them */
+        init_chroma_tables();
+
+        int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        assert(listener >= 0);
+
+        unlink(address.sun_path);
+        if (bind(listener, (struct sockaddr *) &address,
+                 sizeof(address)) != 0 || listen(listener, queue) != 0) {
+                fprintf(stderr, "%s: cannot listen on '%s': %s\n", argv[0],
+                        address.sun_path, strerror(errno));
+                exit(1);
+        }
+
+        struct sigaction action = { .sa_handler = stop };
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGTERM, &action, NULL);
+        sigaction(SIGINT, &action, NULL);
+        signal(SIGPIPE, SIG_IGN);
+
+        pid_t *pids = calloc(workers, sizeof(*pids));
+        assert(pids != NULL);
+
+        for (i = 0; i < workers; i++) {
+                pids[i] = start_worker(listener);
+        }
+
+        /* replace workers that die, until told to stop */
+        while (!stopping) {
+                int status;
+                pid_t pid = wait(&status);
+                if (stopping) {
+                        break;
+                }
+                if (pid < 0) {
+                        if (errno != EINTR) {
+                                break;
+                        }
+                        continue;
+                }
+
+                for (i = 0; i < workers; i++) {
+                        if (pids[i] == pid) {
+                                fprintf(stderr, "%s: worker %d ended, "
+                                        "starting another\n", argv[0],
+                                        (int) pid);
+                                pids[i] = stopping ? 0 :
+                                        start_worker(listener);
+                        }
+                }
+        }
+
+        for (i = 0; i < workers; i++) {
+                if (pids[i] > 0) {
+                        kill(pids[i], SIGTERM);
+                }
+        }
+        while (wait(NULL) > 0) {
+        }
+
+        close(listener);
+        unlink(address.sun_path);
+        free(pids);
+
+        return EXIT_SUCCESS;
+}
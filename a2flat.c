@@ -0,0 +1,121 @@
+/*
+   a2flat.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: A2Methods_T for flat 2D arrays, laid out like a2plain.c. Its
+       default mapping is row major, which walks memory in order.
+*/
+#include <stdlib.h>
+
+#include "a2flat.h"
+#include "uarray2f.h"
+
+static A2Methods_UArray2 new(int width, int height, int size)
+{
+        return UArray2f_new(width, height, size);
+}
+
+static A2Methods_UArray2 new_with_blocksize(int width, int height,
+                                            int size, int blocksize)
+{
+        (void) blocksize;
+        return UArray2f_new(width, height, size);
+}
+
+static void a2free(A2Methods_UArray2 *uarray2p)
+{
+        UArray2f_free((UArray2f_T *) uarray2p);
+}
+
+static int width(A2Methods_UArray2 uarray2)
+{
+        return UArray2f_width(uarray2);
+}
+
+static int height(A2Methods_UArray2 uarray2)
+{
+        return UArray2f_height(uarray2);
+}
+
+static int size(A2Methods_UArray2 uarray2)
+{
+        return UArray2f_size(uarray2);
+}
+
+static int blocksize(A2Methods_UArray2 uarray2)
+{
+        (void) uarray2;
+        return 1;
+}
+
+static A2Methods_Object *at(A2Methods_UArray2 uarray2, int i, int j)
+{
+        return UArray2f_at(uarray2, i, j);
+}
+
+static void map_row_major(A2Methods_UArray2 uarray2,
+                          A2Methods_applyfun apply,
+                          void *cl)
+{
+        UArray2f_map_row_major(uarray2, (UArray2f_applyfun *) apply, cl);
+}
+
+static void map_col_major(A2Methods_UArray2 uarray2,
+                          A2Methods_applyfun apply,
+                          void *cl)
+{
+        UArray2f_map_col_major(uarray2, (UArray2f_applyfun *) apply, cl);
+}
+
+/* The small maps walk the elements directly, since they need no indices */
+static void small_map_row_major(A2Methods_UArray2 a2,
+                                A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        UArray2f_T array2 = a2;
+        int i, j;
+
+        for (j = 0; j < array2->height; j++) {
+                char *elem = UArray2f_row(array2, j);
+
+                for (i = 0; i < array2->width; i++) {
+                        apply(elem, cl);
+                        elem += array2->size;
+                }
+        }
+}
+
+static void small_map_col_major(A2Methods_UArray2 a2,
+                                A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        UArray2f_T array2 = a2;
+        int i, j;
+
+        for (i = 0; i < array2->width; i++) {
+                for (j = 0; j < array2->height; j++) {
+                        apply(UArray2f_at(array2, i, j), cl);
+                }
+        }
+}
+
+static struct A2Methods_T uarray2_methods_flat_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        map_row_major,
+        map_col_major,
+        NULL,
+        map_row_major,
+        small_map_row_major,
+        small_map_col_major,
+        NULL,
+        small_map_row_major
+};
+
+A2Methods_T uarray2_methods_flat = &uarray2_methods_flat_struct;
@@ -0,0 +1,16 @@
+/*
+   a2flat.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: A2Methods_T for flat 2D arrays (uarray2f.h). It can be used
+       anywhere uarray2_methods_plain is, and stores every array in one
+       allocation instead of one per row.
+*/
+#ifndef A2FLAT_INCLUDED
+#define A2FLAT_INCLUDED
+
+#include <a2methods.h>
+
+extern A2Methods_T uarray2_methods_flat;
+
+#endif
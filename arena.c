@@ -0,0 +1,226 @@
+/*
+   arena.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Implementation of an arena that hands out aligned blocks from
+       large memory-mapped slabs.
+*/
+#include "arena.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* Slabs are a whole number of SLAB_SIZE bytes (2 MB, a huge page). With
+    huge pages they are also aligned to it, so that the kernel can back
+    them with huge pages. */
+#define SLAB_SIZE ((size_t) 2 << 20)
+
+/* An arena holding more than this many bytes (32 MB) when it is reset
+    gives all of them back, so that one large image does not pin its memory
+    in a long-running process (40image --batch, 40imaged) for good. Batch
+    buffers, readers and writers take at most 6 MB at -j 4 whatever the
+    image's size; only format 3 tiles held for an output that cannot seek
+    grow with it, to about its compressed size (12-18 MB for a 12 MP
+    photo). So images up to about 20 MP keep their memory, and larger ones
+    sent to a pipe give it back. */
+#define TRIM_SIZE (16 * SLAB_SIZE)
+
+/* Each slab starts with its header, padded to one ARENA_ALIGNMENT line so
+    that the blocks after it stay aligned */
+struct Slab {
+    struct Slab *next;
+    size_t size, used;
+};
+
+/* Slabs are kept newest first, and blocks are taken from the newest one.
+    total counts the bytes of every block taken since the last reset. */
+struct Arena_T {
+    int huge_pages;
+    struct Slab *slabs;
+    size_t total;
+    pthread_mutex_t lock;
+};
+
+/* round_up
+    Purpose: round a size up to a multiple of a power of two.
+
+    Parameters:
+        size_t size - size to round
+        size_t multiple - power of two to round to
+
+    Returns: size_t - rounded size
+*/
+static inline size_t round_up (size_t size, size_t multiple)
+{
+    return (size + multiple - 1) & ~(multiple - 1);
+}
+
+/* map_slab
+    Purpose: map a new slab with room for at least a given number of bytes
+        after its header. Explicit huge pages are used if there are any
+        free, and otherwise the mapping is aligned to a huge page and
+        offered for transparent huge pages.
+
+    Parameters:
+        int huge_pages - nonzero to use huge pages
+        size_t size - bytes needed after the header
+
+    Returns: struct Slab * - new, empty slab
+
+    Errors: Throws an error if it cannot map memory.
+*/
+static struct Slab *map_slab (int huge_pages, size_t size)
+{
+    assert(size <= SIZE_MAX - 2 * SLAB_SIZE);
+    size = round_up(size + ARENA_ALIGNMENT, SLAB_SIZE);
+
+    int protection = PROT_READ | PROT_WRITE;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void *memory = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    if (huge_pages) {
+        memory = mmap(NULL, size, protection, flags | MAP_HUGETLB, -1, 0);
+    }
+#endif
+
+    if (memory == MAP_FAILED && !huge_pages) {
+        memory = mmap(NULL, size, protection, flags, -1, 0);
+        assert(memory != MAP_FAILED);
+    } else if (memory == MAP_FAILED) {
+        /* map one slab too many, then trim it to a huge page boundary */
+        char *mapped = mmap(NULL, size + SLAB_SIZE, protection, flags, -1,
+            0);
+        assert(mapped != MAP_FAILED);
+
+        char *start = (char *) round_up((uintptr_t) mapped, SLAB_SIZE);
+        if (start > mapped) {
+            munmap(mapped, start - mapped);
+        }
+        munmap(start + size, mapped + SLAB_SIZE - start);
+
+#ifdef MADV_HUGEPAGE
+        madvise(start, size, MADV_HUGEPAGE);
+#endif
+        memory = start;
+    }
+
+    struct Slab *slab = memory;
+    slab->next = NULL;
+    slab->size = size;
+    slab->used = ARENA_ALIGNMENT;
+
+    return slab;
+}
+
+/* unmap_slabs
+    Purpose: unmap a list of slabs.
+
+    Parameters: struct Slab *slab - first slab of the list
+*/
+static void unmap_slabs (struct Slab *slab)
+{
+    while (slab != NULL) {
+        struct Slab *next = slab->next;
+        munmap(slab, slab->size);
+        slab = next;
+    }
+}
+
+/* Arena_new
+    Purpose: Create an empty arena.
+
+    Parameters: See arena.h for more info.
+*/
+Arena_T Arena_new (int huge_pages)
+{
+    Arena_T arena = malloc(sizeof(*arena));
+    assert(arena != NULL);
+
+    arena->huge_pages = huge_pages;
+    arena->slabs = NULL;
+    arena->total = 0;
+
+    int made = pthread_mutex_init(&arena->lock, NULL) == 0;
+    assert(made);
+
+    return arena;
+}
+
+/* Arena_alloc
+    Purpose: Get an aligned block of memory from an arena.
+
+    Parameters: See arena.h for more info.
+*/
+void *Arena_alloc (Arena_T arena, size_t size)
+{
+    assert(arena != NULL);
+    assert(size <= SIZE_MAX - 2 * SLAB_SIZE);
+
+    size = round_up(size == 0 ? 1 : size, ARENA_ALIGNMENT);
+
+    pthread_mutex_lock(&arena->lock);
+
+    struct Slab *slab = arena->slabs;
+    if (slab == NULL || slab->size - slab->used < size) {
+        slab = map_slab(arena->huge_pages, size);
+        slab->next = arena->slabs;
+        arena->slabs = slab;
+    }
+
+    void *block = (char *) slab + slab->used;
+    slab->used += size;
+    arena->total += size;
+
+    pthread_mutex_unlock(&arena->lock);
+
+    return block;
+}
+
+/* Arena_reset
+    Purpose: Take back every block of an arena, keeping its memory unless
+        it holds more than TRIM_SIZE bytes.
+
+    Parameters: See arena.h for more info.
+*/
+void Arena_reset (Arena_T arena)
+{
+    assert(arena != NULL);
+
+    size_t held = 0;
+    struct Slab *slab;
+    for (slab = arena->slabs; slab != NULL; slab = slab->next) {
+        held += slab->size;
+    }
+
+    if (held > TRIM_SIZE) {
+        unmap_slabs(arena->slabs);
+        arena->slabs = NULL;
+    } else if (arena->slabs != NULL && arena->slabs->next != NULL) {
+        unmap_slabs(arena->slabs);
+        arena->slabs = map_slab(arena->huge_pages, arena->total);
+    } else if (arena->slabs != NULL) {
+        arena->slabs->used = ARENA_ALIGNMENT;
+    }
+
+    arena->total = 0;
+}
+
+/* Arena_free
+    Purpose: Free an arena and all of its memory.
+
+    Parameters: See arena.h for more info.
+*/
+void Arena_free (Arena_T *arena)
+{
+    assert(arena != NULL && *arena != NULL);
+
+    unmap_slabs((*arena)->slabs);
+    pthread_mutex_destroy(&(*arena)->lock);
+
+    free(*arena);
+    *arena = NULL;
+}
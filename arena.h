@@ -0,0 +1,69 @@
+/*
+   arena.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for an arena that hands out memory for everything an
+       image needs and takes it all back at once, keeping its pages for the
+       next image.
+*/
+#ifndef ARENA_INCLUDED
+#define ARENA_INCLUDED
+
+#include <stddef.h>
+
+/* Memory is carved from large slabs, and every block is aligned to
+        ARENA_ALIGNMENT bytes, a cache line. Blocks are never freed one by
+        one; Arena_reset takes back all of them. */
+#define ARENA_ALIGNMENT 64
+
+typedef struct Arena_T *Arena_T;
+
+/* Arena_new
+    Purpose: Create an empty arena.
+
+    Parameters: int huge_pages - nonzero to back slabs with huge pages where
+        the system has them
+
+    Returns: Arena_T - new arena
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+Arena_T Arena_new (int huge_pages);
+
+/* Arena_alloc
+    Purpose: Get a block of memory from an arena. Blocks can be taken from
+        several threads at once. Its contents are not cleared.
+
+    Parameters:
+        Arena_T arena - arena to take memory from
+        size_t size - bytes needed
+
+    Returns: void * - block of size bytes, aligned to ARENA_ALIGNMENT,
+        that lasts until the arena is reset or freed
+
+    Errors: Throws an error if arena is NULL or if it cannot allocate
+        memory.
+*/
+void *Arena_alloc (Arena_T arena, size_t size);
+
+/* Arena_reset
+    Purpose: Take back every block of an arena, keeping its memory for the
+        blocks that come next. An arena that needed several slabs has them
+        replaced by one slab big enough for all of them, so the same
+        requests are then met from memory that is already mapped in. An
+        arena that holds more than 32 MB gives all of it back instead, so
+        that a large image does not keep its memory after it is done. Must
+        not be called while another thread takes blocks.
+
+    Parameters: Arena_T arena - arena to reset
+*/
+void Arena_reset (Arena_T arena);
+
+/* Arena_free
+    Purpose: Free an arena and all of its memory.
+
+    Parameters: Arena_T *arena - pointer to arena to free
+*/
+void Arena_free (Arena_T *arena);
+
+#endif
@@ -0,0 +1,589 @@
+/*
+   batch.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Functions for compressing or decompressing many files in one
+       run of 40image.
+
+       Errors in compress40 and decompress40 are failed assertions, which
+       end the process. So each file is converted in a worker process
+       forked from 40image: the parent hands out files one at a time over a
+       pipe, and the worker answers over another pipe when a file is done.
+       If a worker ends without answering, the file it was on failed, and
+       a new worker takes its place.
+
+       A worker writes each result to a temporary file named after itself
+       and renames it into place once the result is complete, so a failed
+       file only ever removes its own temporary file.
+*/
+#include "batch.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "options.h"
+#include "io.h"
+
+/* A worker process and the pipes to it. current is the index of the file
+    it is converting, or NO_FILE when it is idle. */
+struct Worker {
+    pid_t pid;
+    int jobs;           /* parent writes file indices here */
+    int replies;        /* parent reads struct Reply here */
+    size_t current;
+};
+
+#define NO_FILE ((size_t) -1)
+
+/* Sent by a worker when it has finished a file. error is 0 on success, or
+    the errno of what went wrong opening or writing the files. */
+struct Reply {
+    uint64_t index;
+    int32_t error;
+};
+
+/* Everything the parent needs to hand out files and start workers */
+struct Batch {
+    char **files;
+    char **outputs;     /* result of each file, or NULL if rejected */
+    size_t nfiles, next;
+    const char *out_dir, *suffix;
+    void (*convert)(FILE *input);
+    struct Worker *workers;
+    unsigned nworkers;
+    unsigned failed;
+};
+
+/* read_list
+    Purpose: read the file names in a list, one per line, skipping blank
+        lines and dropping line endings.
+
+    Parameters:
+        FILE *list - stream to read from
+        size_t *count - pointer to number of names, this value will be set
+
+    Returns: char ** - array of count names, each to be freed with free(),
+        as is the array
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+static char **read_list (FILE *list, size_t *count)
+{
+    size_t capacity = 16;
+    char **files = malloc(capacity * sizeof(*files));
+    assert(files != NULL);
+
+    *count = 0;
+
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+
+    while ((length = getline(&line, &size, list)) >= 0) {
+        while (length > 0 && 
+               (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+
+        if (length == 0) {
+            continue;
+        }
+
+        if (*count == capacity) {
+            capacity *= 2;
+            files = realloc(files, capacity * sizeof(*files));
+            assert(files != NULL);
+        }
+
+        files[*count] = strdup(line);
+        assert(files[*count] != NULL);
+        (*count)++;
+    }
+
+    free(line);
+    return files;
+}
+
+/* output_path
+    Purpose: name the result of converting a file: its name without any
+        directories or extension, in out_dir, ending in suffix.
+
+    Parameters:
+        const char *out_dir - directory to write results into
+        const char *input - name of the file converted
+        const char *suffix - extension of the result
+
+    Returns: char * - name of the result, to be freed with free()
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+static char *output_path (const char *out_dir, const char *input, 
+    const char *suffix)
+{
+    const char *base = strrchr(input, '/');
+    base = base == NULL ? input : base + 1;
+
+    const char *dot = strrchr(base, '.');
+    size_t length = dot == NULL || dot == base ? strlen(base) : 
+        (size_t) (dot - base);
+
+    size_t size = strlen(out_dir) + 1 + length + strlen(suffix) + 1;
+    char *path = malloc(size);
+    assert(path != NULL);
+
+    snprintf(path, size, "%s/%.*s%s", out_dir, (int) length, base, suffix);
+    return path;
+}
+
+/* temp_path
+    Purpose: name the temporary file a worker writes a result into before
+        renaming it into place. The name includes the worker's process id,
+        so no two workers share one and the parent can find it.
+
+    Parameters:
+        const char *output - name of the result
+        pid_t pid - process id of the worker
+
+    Returns: char * - name of the temporary file, to be freed with free()
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+static char *temp_path (const char *output, pid_t pid)
+{
+    size_t size = strlen(output) + 32;
+    char *path = malloc(size);
+    assert(path != NULL);
+
+    snprintf(path, size, "%s.%ld.tmp", output, (long) pid);
+    return path;
+}
+
+/* Used by reject_duplicates to sort results by name */
+struct Named {
+    const char *output;
+    size_t index;
+};
+
+/* compare_named
+    Purpose: order results by name, and results with the same name by the
+        position of their file in the list. Used by qsort.
+
+    Parameters:
+        const void *a - pointer to first struct Named
+        const void *b - pointer to second struct Named
+
+    Returns: int - negative, zero or positive as a sorts before, with or
+        after b
+*/
+static int compare_named (const void *a, const void *b)
+{
+    const struct Named *x = a, *y = b;
+    int order = strcmp(x->output, y->output);
+
+    if (order != 0) {
+        return order;
+    }
+
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+/* report_failure
+    Purpose: tell the user a file failed and remove the temporary file of
+        the worker it ran on, if any. Results of other files are never
+        touched.
+
+    Parameters:
+        struct Batch *batch - batch the file is in
+        size_t index - index of the file
+        pid_t pid - process id of the worker it ran on, or 0 if none
+        const char *reason - what went wrong
+*/
+static void report_failure (struct Batch *batch, size_t index, pid_t pid,
+    const char *reason)
+{
+    fprintf(stderr, "40image: %s: %s\n", batch->files[index], reason);
+
+    if (pid > 0) {
+        char *path = temp_path(batch->outputs[index], pid);
+        unlink(path);
+        free(path);
+    }
+
+    batch->failed++;
+}
+
+/* reject_duplicates
+    Purpose: name every file's result, and reject each file whose result
+        has the same name as that of a file earlier in the list (like
+        a/x.ppm and b/x.ppm), since they would overwrite each other.
+        Rejected files are reported as failed and never converted.
+
+    Parameters: struct Batch *batch - batch whose outputs will be set
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+static void reject_duplicates (struct Batch *batch)
+{
+    batch->outputs = calloc(batch->nfiles + 1, sizeof(char *));
+    struct Named *named = malloc((batch->nfiles + 1) * sizeof(*named));
+    assert(batch->outputs != NULL && named != NULL);
+
+    size_t f;
+    for (f = 0; f < batch->nfiles; f++) {
+        batch->outputs[f] = output_path(batch->out_dir, batch->files[f],
+            batch->suffix);
+        named[f] = (struct Named) { batch->outputs[f], f };
+    }
+
+    qsort(named, batch->nfiles, sizeof(*named), compare_named);
+
+    /* named[first] is the earliest file in the list with a given result */
+    size_t first = 0;
+    for (f = 1; f < batch->nfiles; f++) {
+        if (strcmp(named[f].output, named[first].output) != 0) {
+            first = f;
+            continue;
+        }
+
+        size_t index = named[f].index;
+        char reason[256];
+        snprintf(reason, sizeof(reason), "same result as %s",
+            batch->files[named[first].index]);
+        report_failure(batch, index, 0, reason);
+
+        free(batch->outputs[index]);
+        batch->outputs[index] = NULL;
+    }
+
+    free(named);
+}
+
+/* convert_file
+    Purpose: convert one file of a batch, in a worker. The result is
+        written through stdout, which is pointed at the worker's temporary
+        file, and the temporary file is renamed into place when the result
+        is complete. If anything goes wrong, the temporary file is removed.
+
+    Parameters:
+        struct Batch *batch - batch the file is in
+        size_t index - index of the file
+
+    Returns: int - 0 on success, or the errno of a file that could not be
+        opened or written
+*/
+static int convert_file (struct Batch *batch, size_t index)
+{
+    FILE *input = fopen(batch->files[index], "rb");
+    if (input == NULL) {
+        return errno;
+    }
+
+    char *temp = temp_path(batch->outputs[index], getpid());
+    FILE *output = freopen(temp, "wb", stdout);
+
+    if (output == NULL) {
+        int error = errno;
+        fclose(input);
+        free(temp);
+        return error;
+    }
+
+    batch->convert(input);
+    fclose(input);
+
+    int error = 0;
+    errno = 0;
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        error = errno != 0 ? errno : EIO;
+    } else if (rename(temp, batch->outputs[index]) != 0) {
+        error = errno;
+    }
+
+    if (error != 0) {
+        unlink(temp);
+    }
+
+    free(temp);
+    return error;
+}
+
+/* run_worker
+    Purpose: convert files in a worker process until the parent closes the
+        job pipe, then exit.
+
+    Parameters:
+        struct Batch *batch - batch the files are in
+        int jobs - pipe file indices arrive on
+        int replies - pipe to answer on
+*/
+static void run_worker (struct Batch *batch, int jobs, int replies)
+{
+    /* Files are converted in parallel by the workers, not within them */
+    compress40_options.threads = 1;
+
+    uint64_t index;
+    while (full_io(jobs, &index, sizeof(index), 0)) {
+        struct Reply reply = { index, 0 };
+
+        reply.error = index < batch->nfiles && 
+            batch->outputs[index] != NULL ? 
+            convert_file(batch, index) : EINVAL;
+
+        if (!full_io(replies, &reply, sizeof(reply), 1)) {
+            break;
+        }
+    }
+
+    compress40_release();
+    exit(EXIT_SUCCESS);
+}
+
+/* start_worker
+    Purpose: fork a worker process and set up its pipes. The worker closes
+        every other worker's pipes, so that each pipe's only other end is
+        in the parent and closing it is seen by the worker.
+
+    Parameters:
+        struct Batch *batch - batch the worker works on
+        unsigned w - index of the worker to start
+
+    Errors: Throws an error if it cannot make a pipe or fork.
+*/
+static void start_worker (struct Batch *batch, unsigned w)
+{
+    int jobs[2], replies[2];
+    int made = pipe(jobs) == 0 && pipe(replies) == 0;
+    assert(made);
+
+    fflush(NULL);
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        unsigned other;
+        for (other = 0; other < batch->nworkers; other++) {
+            if (batch->workers[other].pid > 0) {
+                close(batch->workers[other].jobs);
+                close(batch->workers[other].replies);
+            }
+        }
+
+        close(jobs[1]);
+        close(replies[0]);
+        run_worker(batch, jobs[0], replies[1]);
+    }
+
+    close(jobs[0]);
+    close(replies[1]);
+
+    batch->workers[w].pid = pid;
+    batch->workers[w].jobs = jobs[1];
+    batch->workers[w].replies = replies[0];
+    batch->workers[w].current = NO_FILE;
+}
+
+/* stop_worker
+    Purpose: close a worker's pipes and wait for it to exit.
+
+    Parameters:
+        struct Batch *batch - batch the worker works on
+        unsigned w - index of the worker
+
+    Returns: int - the worker's status, as from waitpid
+*/
+static int stop_worker (struct Batch *batch, unsigned w)
+{
+    struct Worker *worker = &batch->workers[w];
+
+    close(worker->jobs);
+    close(worker->replies);
+
+    int status = 0;
+    while (waitpid(worker->pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    worker->pid = 0;
+    return status;
+}
+
+/* hand_out
+    Purpose: give a worker the next file that was not rejected, or close its
+        job pipe and let it exit if there are no files left.
+
+    Parameters:
+        struct Batch *batch - batch to take files from
+        unsigned w - index of an idle worker
+
+    Returns: int - 1 if the worker was given a file, 0 if it was stopped
+*/
+static int hand_out (struct Batch *batch, unsigned w)
+{
+    struct Worker *worker = &batch->workers[w];
+
+    while (batch->next < batch->nfiles && 
+           batch->outputs[batch->next] == NULL) {
+        batch->next++;
+    }
+
+    if (batch->next == batch->nfiles) {
+        stop_worker(batch, w);
+        return 0;
+    }
+
+    uint64_t index = batch->next++;
+    worker->current = index;
+
+    /* a worker only goes away on its own while converting a file, so
+        an idle one can always take the next */
+    int sent = full_io(worker->jobs, &index, sizeof(index), 1);
+    assert(sent);
+
+    return 1;
+}
+
+/* batch40
+    Purpose: Run convert on every file named in a list, writing each result
+        to its own file in out_dir, named after the input with its extension
+        replaced by suffix. Files are shared out among worker processes,
+        each of which runs convert single-threaded on one file after another
+        and so reuses compress40's threads and buffers. Each result is
+        written to a temporary file and renamed into place when complete.
+        A file that cannot be opened or that makes convert fail (including
+        failed assertions) is reported on stderr and its temporary file
+        removed; the worker it ran on is replaced and the batch carries on.
+        A file whose result would have the same name as an earlier file's
+        is reported and skipped before any worker starts.
+
+    Parameters:
+        FILE *list - stream of file names, one per line; blank lines are
+            skipped
+        const char *out_dir - existing directory to write results into
+        void (*convert)(FILE *input) - compress40, decompress40 or another
+            function that reads input and writes its result to stdout
+        const char *suffix - extension of the results, like ".c40"
+        unsigned workers - number of worker processes
+
+    Returns: unsigned - number of files that failed
+
+    Errors: Throws an error if list, out_dir, convert or suffix is NULL, if
+        workers is 0, or if it cannot allocate memory or start a worker.
+*/
+unsigned batch40 (FILE *list, const char *out_dir, 
+    void (*convert)(FILE *input), const char *suffix, unsigned workers)
+{
+    assert(list != NULL && out_dir != NULL);
+    assert(convert != NULL && suffix != NULL);
+    assert(workers > 0);
+
+    struct Batch batch = {
+        .out_dir = out_dir,
+        .suffix = suffix,
+        .convert = convert,
+        .next = 0,
+        .failed = 0
+    };
+
+    batch.files = read_list(list, &batch.nfiles);
+    reject_duplicates(&batch);
+
+    if (workers > batch.nfiles) {
+        workers = batch.nfiles;
+    }
+    batch.nworkers = workers;
+
+    batch.workers = calloc(workers + 1, sizeof(struct Worker));
+    struct pollfd *polls = calloc(workers + 1, sizeof(struct pollfd));
+    unsigned *polled = calloc(workers + 1, sizeof(unsigned));
+    assert(batch.workers != NULL && polls != NULL && polled != NULL);
+
+    /* a write to a worker that just died fails instead of killing us */
+    signal(SIGPIPE, SIG_IGN);
+
+    unsigned w, busy = 0;
+    for (w = 0; w < workers; w++) {
+        start_worker(&batch, w);
+        busy += hand_out(&batch, w);
+    }
+
+    while (busy > 0) {
+        unsigned n = 0;
+        for (w = 0; w < workers; w++) {
+            if (batch.workers[w].pid > 0) {
+                polls[n].fd = batch.workers[w].replies;
+                polls[n].events = POLLIN;
+                polled[n++] = w;
+            }
+        }
+
+        if (poll(polls, n, -1) < 0) {
+            assert(errno == EINTR);
+            continue;
+        }
+
+        unsigned i;
+        for (i = 0; i < n; i++) {
+            if (polls[i].revents == 0) {
+                continue;
+            }
+
+            w = polled[i];
+            struct Worker *worker = &batch.workers[w];
+            struct Reply reply;
+
+            if (full_io(worker->replies, &reply, sizeof(reply), 0) &&
+                reply.index == worker->current) {
+                if (reply.error != 0) {
+                    report_failure(&batch, reply.index, worker->pid,
+                        strerror(reply.error));
+                }
+            } else {
+                /* the worker ended without finishing its file */
+                size_t index = worker->current;
+                pid_t pid = worker->pid;
+                int status = stop_worker(&batch, w);
+
+                char reason[64];
+                if (WIFSIGNALED(status)) {
+                    snprintf(reason, sizeof(reason), 
+                        "failed (signal %d)", WTERMSIG(status));
+                } else {
+                    snprintf(reason, sizeof(reason), 
+                        "failed (exit status %d)", WEXITSTATUS(status));
+                }
+                report_failure(&batch, index, pid, reason);
+
+                busy--;
+                if (batch.next < batch.nfiles) {
+                    start_worker(&batch, w);
+                    busy += hand_out(&batch, w);
+                }
+                continue;
+            }
+
+            busy--;
+            busy += hand_out(&batch, w);
+        }
+    }
+
+    size_t f;
+    for (f = 0; f < batch.nfiles; f++) {
+        free(batch.files[f]);
+        free(batch.outputs[f]);
+    }
+    free(batch.files);
+    free(batch.outputs);
+    free(batch.workers);
+    free(polls);
+    free(polled);
+
+    return batch.failed;
+}
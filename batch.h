@@ -0,0 +1,43 @@
+/*
+   batch.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for compressing or decompressing many files in one
+       run of 40image.
+*/
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+
+#include <stdio.h>
+
+/* batch40
+    Purpose: Run convert on every file named in a list, writing each result
+        to its own file in out_dir, named after the input with its extension
+        replaced by suffix. Files are shared out among worker processes,
+        each of which runs convert single-threaded on one file after another
+        and so reuses compress40's threads and buffers. Each result is
+        written to a temporary file and renamed into place when complete.
+        A file that cannot be opened or that makes convert fail (including
+        failed assertions) is reported on stderr and its temporary file
+        removed; the worker it ran on is replaced and the batch carries on.
+        A file whose result would have the same name as an earlier file's
+        is reported and skipped before any worker starts.
+
+    Parameters:
+        FILE *list - stream of file names, one per line; blank lines are
+            skipped
+        const char *out_dir - existing directory to write results into
+        void (*convert)(FILE *input) - compress40, decompress40 or another
+            function that reads input and writes its result to stdout
+        const char *suffix - extension of the results, like ".c40"
+        unsigned workers - number of worker processes
+
+    Returns: unsigned - number of files that failed
+
+    Errors: Throws an error if list, out_dir, convert or suffix is NULL, if
+        workers is 0, or if it cannot allocate memory or start a worker.
+*/
+unsigned batch40 (FILE *list, const char *out_dir, 
+        void (*convert)(FILE *input), const char *suffix, unsigned workers);
+
+#endif
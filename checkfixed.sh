@@ -0,0 +1,96 @@
+#!/bin/sh
+#
+#  checkfixed.sh
+#  Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+#  Date: 27 October 2021
+#  Purpose: Check that the fixed-point pipeline (40image --fixed) stays
+#      within the error bounds given for fixed.c in the README, by running
+#      both pipelines on each PPM and comparing the results with ppmdiff.
+#      With no arguments it makes its own small test images: odd sizes and
+#      maxvals of 1, 255, 1000 and 65535. Run by "make check-fixed".
+#
+#  Usage: checkfixed.sh [image.ppm ...]
+#
+#  For each image it checks that
+#      - decompressing the same codewords, the two pipelines' outputs are
+#        within DECOMPRESS_BOUND of each other
+#      - compressing and decompressing, the two pipelines' outputs are
+#        within PIPELINE_BOUND of each other
+#      - the fixed pipeline's output is no more than ORIGINAL_BOUND further
+#        from the original image than the double pipeline's
+#  and exits with status 1 if any check fails.
+
+DECOMPRESS_BOUND=0.0005
+PIPELINE_BOUND=0.005
+ORIGINAL_BOUND=0.0005
+
+IMAGE40=${IMAGE40:-./40image}
+PPMDIFF=${PPMDIFF:-./ppmdiff}
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+# make_image width height maxval seed file
+#     Writes a plain (P3) PPM of smooth color with some noise
+make_image () {
+    awk -v w="$1" -v h="$2" -v m="$3" -v seed="$4" 'BEGIN {
+        srand(seed)
+        printf "P3\n%d %d\n%d\n", w, h, m
+        for (y = 0; y < h; y++) {
+            for (x = 0; x < w; x++) {
+                for (c = 0; c < 3; c++) {
+                    v = 0.5 + 0.35 * sin(x / 9 + c) * cos(y / 13 - c)
+                    v = int(m * (v + (rand() - 0.5) / 8) + 0.5)
+                    printf "%d\n", v < 0 ? 0 : (v > m ? m : v)
+                }
+            }
+        }
+    }' > "$5"
+}
+
+if [ $# -eq 0 ]; then
+    make_image 123 77 255 1 "$work/123x77-255.ppm"
+    make_image 40 30 1000 2 "$work/40x30-1000.ppm"
+    make_image 41 29 65535 3 "$work/41x29-65535.ppm"
+    make_image 17 200 1 4 "$work/17x200-1.ppm"
+    make_image 256 192 255 5 "$work/256x192-255.ppm"
+    set -- "$work"/*.ppm
+fi
+
+# within difference bound
+#     Succeeds if difference is at most bound
+within () {
+    awk -v diff="$1" -v bound="$2" 'BEGIN { exit !(diff <= bound) }'
+}
+
+status=0
+for image in "$@"; do
+    "$IMAGE40" -c "$image" > "$work/double.c40" &&
+    "$IMAGE40" -c --fixed "$image" > "$work/fixed.c40" &&
+    "$IMAGE40" -d "$work/double.c40" > "$work/double.ppm" &&
+    "$IMAGE40" -d --fixed "$work/double.c40" > "$work/decoded.ppm" &&
+    "$IMAGE40" -d --fixed "$work/fixed.c40" > "$work/fixed.ppm" || {
+        echo "$image: 40image failed"
+        status=1
+        continue
+    }
+
+    decompress=$("$PPMDIFF" "$work/double.ppm" "$work/decoded.ppm")
+    pipeline=$("$PPMDIFF" "$work/double.ppm" "$work/fixed.ppm")
+    double=$("$PPMDIFF" "$image" "$work/double.ppm")
+    fixed=$("$PPMDIFF" "$image" "$work/fixed.ppm")
+    original=$(awk -v a="$fixed" -v b="$double" 'BEGIN { print a - b }')
+
+    result=ok
+    within "$decompress" $DECOMPRESS_BOUND &&
+    within "$pipeline" $PIPELINE_BOUND &&
+    within "$original" $ORIGINAL_BOUND || {
+        result=FAILED
+        status=1
+    }
+
+    echo "$(basename "$image"): decompress $decompress pipeline $pipeline" \
+        "original $double (double) $fixed (fixed) $result"
+done
+
+exit $status
@@ -0,0 +1,120 @@
+/*
+   chroma.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Builds the tables used by the inline chroma quantizer in
+       chroma.h from the arith40 library.
+*/
+#include "chroma.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <arith40.h>
+
+float chroma_values[CHROMA_LEVELS];
+float chroma_thresholds[CHROMA_LEVELS - 1];
+
+static pthread_once_t chroma_once = PTHREAD_ONCE_INIT;
+
+/* float_to_ordered
+    Purpose: map a float to an unsigned integer such that comparing two
+        integers gives the same result as comparing the floats (-0.0 comes
+        just before 0.0). Not meaningful for NaN.
+
+    Parameters: float x - float to map
+
+    Returns: uint32_t - ordered integer
+*/
+static uint32_t float_to_ordered (float x)
+{
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+
+    if (bits & 0x80000000u) {
+        return ~bits;
+    }
+    return bits | 0x80000000u;
+}
+
+/* ordered_to_float
+    Purpose: inverse of float_to_ordered
+
+    Parameters: uint32_t n - ordered integer
+
+    Returns: float - float n stands for
+*/
+static float ordered_to_float (uint32_t n)
+{
+    uint32_t bits = (n & 0x80000000u) ? (n & 0x7fffffffu) : ~n;
+
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+/* find_threshold
+    Purpose: binary search over every float from -FLT_MAX to FLT_MAX for the
+        smallest one that arith40 quantizes to an index greater than k.
+        Relies on Arith40_index_of_chroma never decreasing as x increases.
+
+    Parameters: unsigned k - index to find the upper threshold of
+
+    Returns: float - threshold, or an infinity if every finite float is on
+        the same side of it
+*/
+static float find_threshold (unsigned k)
+{
+    uint32_t low = float_to_ordered(-FLT_MAX);
+    uint32_t high = float_to_ordered(FLT_MAX);
+
+    if (Arith40_index_of_chroma(-FLT_MAX) > k) {
+        return -INFINITY;
+    } else if (Arith40_index_of_chroma(FLT_MAX) <= k) {
+        return INFINITY;
+    }
+
+    /* index(low) <= k < index(high) throughout; high is the answer once
+        they meet */
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+
+        if (Arith40_index_of_chroma(ordered_to_float(mid)) > k) {
+            high = mid;
+        } else {
+            low = mid;
+        }
+    }
+
+    return ordered_to_float(high);
+}
+
+/* build_chroma_tables
+    Purpose: fill in chroma_values and chroma_thresholds. Called once by
+        init_chroma_tables.
+*/
+static void build_chroma_tables (void)
+{
+    unsigned i;
+    for (i = 0; i < CHROMA_LEVELS; i++) {
+        chroma_values[i] = Arith40_chroma_of_index(i);
+    }
+
+    for (i = 0; i < CHROMA_LEVELS - 1; i++) {
+        chroma_thresholds[i] = find_threshold(i);
+        assert(i == 0 || chroma_thresholds[i] >= chroma_thresholds[i - 1]);
+    }
+}
+
+/* init_chroma_tables
+    Purpose: Fill in chroma_values and chroma_thresholds from the arith40
+        library. Safe to call any number of times from any thread; only the
+        first call does any work. Must be called before chroma_to_index or
+        index_to_chroma.
+*/
+void init_chroma_tables (void)
+{
+    pthread_once(&chroma_once, build_chroma_tables);
+}
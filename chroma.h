@@ -0,0 +1,67 @@
+/*
+   chroma.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Inlinable chroma quantization that gives the same results as
+       the arith40 library. The tables are filled in from arith40 itself by
+       init_chroma_tables, so there is nothing to keep in sync by hand.
+*/
+#ifndef CHROMA_INCLUDED
+#define CHROMA_INCLUDED
+
+#include <assert.h>
+
+/* Number of chroma values arith40 can quantize to (a 4-bit index) */
+#define CHROMA_LEVELS 16
+
+/* chroma_values[i] is Arith40_chroma_of_index(i). chroma_thresholds[k] is
+    the smallest float whose index is greater than k, so the index of x is
+    the number of thresholds at or below x. Both are plain arrays so vector
+    kernels can broadcast them and compare several chromas at once. */
+extern float chroma_values[CHROMA_LEVELS];
+extern float chroma_thresholds[CHROMA_LEVELS - 1];
+
+/* init_chroma_tables
+    Purpose: Fill in chroma_values and chroma_thresholds from the arith40
+        library. Safe to call any number of times from any thread; only the
+        first call does any work. Must be called before chroma_to_index or
+        index_to_chroma.
+*/
+void init_chroma_tables (void);
+
+/* chroma_to_index
+    Purpose: Quantize a chroma value to a 4-bit index. Same result as
+        Arith40_index_of_chroma for every float except NaN.
+
+    Parameters: float x - chroma value to quantize
+
+    Returns: unsigned - index of the closest quantized chroma
+*/
+static inline unsigned chroma_to_index (float x)
+{
+    unsigned index = 0;
+
+    /* no branches, the compiler unrolls this into compares and adds */
+    int k;
+    for (k = 0; k < CHROMA_LEVELS - 1; k++) {
+        index += (x >= chroma_thresholds[k]);
+    }
+
+    return index;
+}
+
+/* index_to_chroma
+    Purpose: Get the chroma value a 4-bit index stands for. Same result as
+        Arith40_chroma_of_index.
+
+    Parameters: unsigned index - index of chroma, less than CHROMA_LEVELS
+
+    Returns: float - chroma value
+*/
+static inline float index_to_chroma (unsigned index)
+{
+    assert(index < CHROMA_LEVELS);
+    return chroma_values[index];
+}
+
+#endif
@@ -0,0 +1,363 @@
+/*
+   codec40.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: The codec library's interface: contexts, and functions for
+       compressing and decompressing images held in streams, in memory or
+       passed through callbacks. Buffers and callbacks are wrapped in stdio
+       streams (fmemopen, open_memstream and fopencookie), so they go
+       through exactly the same code as files and give the same bytes.
+*/
+#define _GNU_SOURCE
+#include "codec40.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "context.h"
+
+/* Compresses or decompresses from one stream to another */
+typedef int Convert_fun (Codec40 codec, FILE *input, FILE *output);
+
+/* release_pending
+    Purpose: Close the streams and free the output buffer of a buffer or
+        callback conversion, whether it finished or was cut short by a
+        failed assertion. A writer callback is not called again, so nothing
+        more reaches the caller once a conversion is over.
+
+    Parameters: Codec40 codec - context whose pending conversion to release
+*/
+static void release_pending (Codec40 codec)
+{
+    struct Pending *pending = &codec->pending;
+
+    if (pending->input != NULL) {
+        fclose(pending->input);
+    }
+
+    if (pending->output != NULL) {
+        pending->writer.failed = 1;
+        fclose(pending->output);
+    }
+
+    free(pending->buffer);
+    memset(pending, 0, sizeof(*pending));
+}
+
+/* Codec40_new
+    Purpose: Create a codec context. Different contexts can be used from
+        different threads at once.
+
+    Parameters: See codec40.h for more info.
+*/
+Codec40 Codec40_new (Options_T options)
+{
+    int known = options.threads > 0 &&
+        (options.format == PLAIN_FORMAT || options.format == TILED_FORMAT) &&
+        (options.predictor == NO_PREDICTOR ||
+        (options.predictor == MED_PREDICTOR &&
+        options.format == TILED_FORMAT));
+
+    if (!known) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Codec40 codec = calloc(1, sizeof(*codec));
+    if (codec != NULL) {
+        codec->options = options;
+    }
+
+    return codec;
+}
+
+/* Codec40_free
+    Purpose: Free a codec context, its working memory and anything left
+        by a conversion that was cut short.
+
+    Parameters: See codec40.h for more info.
+*/
+void Codec40_free (Codec40 *codec)
+{
+    if (codec == NULL || *codec == NULL) {
+        return;
+    }
+
+    release_pending(*codec);
+    free_workspace(&(*codec)->workspace);
+    free(*codec);
+    *codec = NULL;
+}
+
+/* Codec40_compress_file
+    Purpose: Compress a PPM from one stream to another.
+
+    Parameters: See codec40.h for more info.
+*/
+int Codec40_compress_file (Codec40 codec, FILE *input, FILE *output)
+{
+    if (codec != NULL) {
+        release_pending(codec);
+    }
+
+    return compress_image(codec, input, output);
+}
+
+/* Codec40_decompress_file
+    Purpose: Decompress a compressed image from one stream to another.
+
+    Parameters: See codec40.h for more info.
+*/
+int Codec40_decompress_file (Codec40 codec, FILE *input, FILE *output)
+{
+    if (codec != NULL) {
+        release_pending(codec);
+    }
+
+    return decompress_image(codec, input, output);
+}
+
+/* Codec40_decompress_region
+    Purpose: Decompress a rectangle of a compressed image from one stream
+        to another.
+
+    Parameters: See codec40.h for more info.
+*/
+int Codec40_decompress_region (Codec40 codec, FILE *input, FILE *output,
+    unsigned x, unsigned y, unsigned width, unsigned height)
+{
+    if (codec != NULL) {
+        release_pending(codec);
+    }
+
+    return decompress_region(codec, input, output, x, y, width, height);
+}
+
+/* Codec40_decompress_thumbnail
+    Purpose: Decompress a compressed image at half its width and height
+        from one stream to another.
+
+    Parameters: See codec40.h for more info.
+*/
+int Codec40_decompress_thumbnail (Codec40 codec, FILE *input, FILE *output)
+{
+    if (codec != NULL) {
+        release_pending(codec);
+    }
+
+    return decompress_thumbnail(codec, input, output);
+}
+
+/* read_callback
+    Purpose: read from a stream made by convert_callbacks. Called by stdio.
+
+    Parameters: See cookie_read_function_t for more info.
+*/
+static ssize_t read_callback (void *cookie, char *bytes, size_t size)
+{
+    struct Callback *callback = cookie;
+
+    return callback->read(callback->cl, bytes, size);
+}
+
+/* write_callback
+    Purpose: write to a stream made by convert_callbacks. A writer that
+        does not take every byte fails the stream, and is not called again.
+        Called by stdio.
+
+    Parameters: See cookie_write_function_t for more info.
+*/
+static ssize_t write_callback (void *cookie, const char *bytes, size_t size)
+{
+    struct Callback *callback = cookie;
+
+    if (!callback->failed &&
+        callback->write(callback->cl, bytes, size) != size) {
+        callback->failed = 1;
+    }
+
+    if (callback->failed) {
+        errno = EIO;
+        return -1;
+    }
+
+    return size;
+}
+
+/* close_output
+    Purpose: Close the output stream of a pending conversion, flushing what
+        is left of its output.
+
+    Parameters:
+        Codec40 codec - context whose output to close
+        int error - error of the conversion so far
+
+    Returns: int - error if it is not 0, or else 0, or EIO or the errno of
+        the failure if the output could not be written
+*/
+static int close_output (Codec40 codec, int error)
+{
+    FILE *output = codec->pending.output;
+    codec->pending.output = NULL;
+
+    if (fclose(output) != 0 && error == 0) {
+        error = errno != 0 ? errno : EIO;
+    }
+
+    return error;
+}
+
+/* convert_buffer
+    Purpose: run a conversion from one memory buffer into a new one.
+
+    Parameters:
+        Codec40 codec - context to use
+        Convert_fun convert - conversion to run
+        const void *input - input bytes
+        size_t length - number of input bytes
+        char **output - pointer to output, this value will be set to a
+            buffer to be freed with free() if the conversion succeeds
+        size_t *output_length - pointer to output size, this value will be
+            set if the conversion succeeds
+
+    Returns: int - 0, EINVAL if any pointer is NULL or length is 0, the
+        error from convert, or the errno of a failure to make a stream or
+        allocate memory. Output of a conversion that failed is freed.
+*/
+static int convert_buffer (Codec40 codec, Convert_fun convert,
+    const void *input, size_t length, char **output, size_t *output_length)
+{
+    if (codec == NULL || input == NULL || length == 0 || output == NULL ||
+        output_length == NULL) {
+        return EINVAL;
+    }
+
+    release_pending(codec);
+    struct Pending *pending = &codec->pending;
+
+    /* fmemopen only reads the buffer in "r" mode */
+    pending->input = fmemopen((void *) input, length, "r");
+    pending->output = open_memstream(&pending->buffer, &pending->length);
+    if (pending->input == NULL || pending->output == NULL) {
+        int error = errno != 0 ? errno : ENOMEM;
+        release_pending(codec);
+        return error;
+    }
+
+    int error = convert(codec, pending->input, pending->output);
+    error = close_output(codec, error);
+
+    if (error == 0) {
+        *output = pending->buffer;
+        *output_length = pending->length;
+        pending->buffer = NULL;
+    }
+
+    release_pending(codec);
+    return error;
+}
+
+/* convert_callbacks
+    Purpose: run a conversion that reads through one callback and writes
+        through another.
+
+    Parameters:
+        Codec40 codec - context to use
+        Convert_fun convert - conversion to run
+        Codec40_reader *read - called for input
+        void *read_cl - closure passed to read
+        Codec40_writer *write - called with output
+        void *write_cl - closure passed to write
+
+    Returns: int - 0, EINVAL if codec, read or write is NULL, the error
+        from convert, EIO if write does not take all of the output, or the
+        errno of a failure to make a stream
+*/
+static int convert_callbacks (Codec40 codec, Convert_fun convert,
+    Codec40_reader *read, void *read_cl, Codec40_writer *write,
+    void *write_cl)
+{
+    if (codec == NULL || read == NULL || write == NULL) {
+        return EINVAL;
+    }
+
+    release_pending(codec);
+    struct Pending *pending = &codec->pending;
+
+    pending->reader = (struct Callback) { read, NULL, read_cl, 0 };
+    pending->writer = (struct Callback) { NULL, write, write_cl, 0 };
+
+    cookie_io_functions_t read_functions = { .read = read_callback };
+    cookie_io_functions_t write_functions = { .write = write_callback };
+
+    pending->input = fopencookie(&pending->reader, "r", read_functions);
+    pending->output = fopencookie(&pending->writer, "w", write_functions);
+    if (pending->input == NULL || pending->output == NULL) {
+        int error = errno != 0 ? errno : ENOMEM;
+        release_pending(codec);
+        return error;
+    }
+
+    int error = convert(codec, pending->input, pending->output);
+    error = close_output(codec, error);
+
+    if (error == 0 && pending->writer.failed) {
+        error = EIO;
+    }
+
+    release_pending(codec);
+    return error;
+}
+
+/* Codec40_compress_buffer
+    Purpose: Compress a PPM held in memory into a new buffer.
+
+    Parameters: See codec40.h for more info.
+*/
+int Codec40_compress_buffer (Codec40 codec, const void *input,
+    size_t length, char **output, size_t *output_length)
+{
+    return convert_buffer(codec, compress_image, input, length, output,
+        output_length);
+}
+
+/* Codec40_decompress_buffer
+    Purpose: Decompress a compressed image held in memory into a new
+        buffer holding a PPM.
+
+    Parameters: See codec40.h for more info.
+*/
+int Codec40_decompress_buffer (Codec40 codec, const void *input,
+    size_t length, char **output, size_t *output_length)
+{
+    return convert_buffer(codec, decompress_image, input, length, output,
+        output_length);
+}
+
+/* Codec40_compress_callbacks
+    Purpose: Compress a PPM read through one callback, writing the
+        compressed image through another.
+
+    Parameters: See codec40.h for more info.
+*/
+int Codec40_compress_callbacks (Codec40 codec, Codec40_reader *read,
+    void *read_cl, Codec40_writer *write, void *write_cl)
+{
+    return convert_callbacks(codec, compress_image, read, read_cl, write,
+        write_cl);
+}
+
+/* Codec40_decompress_callbacks
+    Purpose: Decompress a compressed image read through one callback,
+        writing the PPM through another.
+
+    Parameters: See codec40.h for more info.
+*/
+int Codec40_decompress_callbacks (Codec40 codec, Codec40_reader *read,
+    void *read_cl, Codec40_writer *write, void *write_cl)
+{
+    return convert_callbacks(codec, decompress_image, read, read_cl, write,
+        write_cl);
+}
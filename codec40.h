@@ -0,0 +1,202 @@
+/*
+   codec40.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for embedding the image codec in another program,
+       built as libcodec40.a and libcodec40.so. A Codec40 holds the options
+       and working memory (thread pool and batch buffers) for compressing
+       and decompressing, and can be reused for any number of images, one
+       at a time. Images are read from and written to stdio streams, memory
+       buffers or caller-supplied callbacks.
+
+       Conversions return 0, or an errno value: EINVAL for bad arguments or
+       input that is not a PPM or a compressed image, EBADMSG for input
+       that is malformed or ends early (a short raster, a bad header or
+       tile index, or tiles that do not decode), EIO or the errno of the
+       failure when input cannot be read or output cannot be written, and
+       the errno of a failure to make a stream or allocate memory. Output
+       of a failed conversion to a buffer is freed; what was written to a
+       stream or callback before the failure is left there.
+
+       Misuse of the interface and running out of memory part way through
+       an image are still failed assertions (Assert_Failed), as in the rest
+       of the codec. CII's exception stack is shared by every thread, so
+       the library does not catch them; a conversion cut short that way
+       leaves its streams and buffer in the context, which closes and frees
+       them on its next call or in Codec40_free.
+*/
+#ifndef CODEC40_INCLUDED
+#define CODEC40_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "options.h"
+
+typedef struct Codec40 *Codec40;
+
+/* Codec40_reader is called for more input. It stores up to size bytes in
+    bytes and returns how many it stored, or 0 at the end of the input. */
+typedef size_t Codec40_reader (void *cl, char *bytes, size_t size);
+
+/* Codec40_writer is called with output. It returns how many bytes it
+    took; taking fewer than size is an error. */
+typedef size_t Codec40_writer (void *cl, const char *bytes, size_t size);
+
+/* Codec40_new
+    Purpose: Create a codec context. Different contexts can be used from
+        different threads at once.
+
+    Parameters: Options_T options - threads to use, kernels, and format
+        (PLAIN_FORMAT or TILED_FORMAT) and predictor (NO_PREDICTOR, or
+        MED_PREDICTOR with TILED_FORMAT) to write, as for 40image. All are
+        defined in options.h
+
+    Returns: Codec40 - new context, or NULL with errno set to EINVAL if
+        options.threads is 0 or the format or predictor is not known, or
+        to ENOMEM if it cannot allocate memory
+*/
+Codec40 Codec40_new (Options_T options);
+
+/* Codec40_free
+    Purpose: Free a codec context and its working memory. Does nothing if
+        codec or *codec is NULL.
+
+    Parameters: Codec40 *codec - pointer to context to free, this value
+        will be set to NULL
+*/
+void Codec40_free (Codec40 *codec);
+
+/* Codec40_compress_file
+    Purpose: Compress a PPM from one stream to another, as compress40 does
+        to stdout.
+
+    Parameters:
+        Codec40 codec - context to use
+        FILE *input - stream to read a PPM from
+        FILE *output - stream to write the compressed image to
+
+    Returns: int - 0, EINVAL if any argument is NULL or the input is not a
+        PPM, EBADMSG if the input is malformed, or EIO or the errno of the
+        failure if the output cannot be written
+*/
+int Codec40_compress_file (Codec40 codec, FILE *input, FILE *output);
+
+/* Codec40_decompress_file
+    Purpose: Decompress a compressed image of either format from one
+        stream to another, as decompress40 does to stdout.
+
+    Parameters:
+        Codec40 codec - context to use
+        FILE *input - stream to read a compressed image from
+        FILE *output - stream to write the PPM to
+
+    Returns: int - 0, EINVAL if any argument is NULL or the input is not a
+        compressed image, EBADMSG if the input is malformed, or EIO or the
+        errno of the failure if the input cannot be read or the output
+        cannot be written
+*/
+int Codec40_decompress_file (Codec40 codec, FILE *input, FILE *output);
+
+/* Codec40_decompress_region
+    Purpose: Decompress only a rectangle of a compressed image from one
+        stream to another, as 40image --crop does to stdout. The rectangle
+        is clipped to the image.
+
+    Parameters:
+        Codec40 codec - context to use
+        FILE *input - stream to read a compressed image from
+        FILE *output - stream to write the PPM to
+        unsigned x - column of the rectangle's left edge, in pixels
+        unsigned y - row of the rectangle's top edge, in pixels
+        unsigned width - width of the rectangle, in pixels
+        unsigned height - height of the rectangle, in pixels
+
+    Returns: int - 0, EINVAL if any argument is NULL, if the input is not
+        a compressed image or if the rectangle is empty or starts outside
+        the image, EBADMSG if the input is malformed, or EIO or the errno
+        of the failure if the input cannot be read or the output cannot be
+        written
+*/
+int Codec40_decompress_region (Codec40 codec, FILE *input, FILE *output,
+        unsigned x, unsigned y, unsigned width, unsigned height);
+
+/* Codec40_decompress_thumbnail
+    Purpose: Decompress a compressed image at half its width and height
+        from one stream to another, as 40image --thumbnail does to stdout.
+
+    Parameters: Same as Codec40_decompress_file.
+
+    Returns: Same as Codec40_decompress_file.
+*/
+int Codec40_decompress_thumbnail (Codec40 codec, FILE *input, 
+        FILE *output);
+
+/* Codec40_compress_buffer
+    Purpose: Compress a PPM held in memory into a new buffer.
+
+    Parameters:
+        Codec40 codec - context to use
+        const void *input - the PPM's bytes
+        size_t length - number of bytes in input
+        char **output - pointer to compressed image, this value will be set
+            to a buffer to be freed with free()
+        size_t *output_length - pointer to size of the compressed image,
+            this value will be set
+
+        output and output_length are only set if it returns 0.
+
+    Returns: int - 0, EINVAL if any pointer is NULL, length is 0 or the
+        input is not a PPM, EBADMSG if the input is malformed, or the errno
+        of a failure to make a stream or allocate memory
+*/
+int Codec40_compress_buffer (Codec40 codec, const void *input, 
+        size_t length, char **output, size_t *output_length);
+
+/* Codec40_decompress_buffer
+    Purpose: Decompress a compressed image held in memory into a new
+        buffer holding a PPM.
+
+    Parameters: Same as Codec40_compress_buffer.
+
+    Returns: Same as Codec40_compress_buffer, with EINVAL if the input is
+        not a compressed image.
+*/
+int Codec40_decompress_buffer (Codec40 codec, const void *input, 
+        size_t length, char **output, size_t *output_length);
+
+/* Codec40_compress_callbacks
+    Purpose: Compress a PPM read through one callback, writing the
+        compressed image through another.
+
+    Parameters:
+        Codec40 codec - context to use
+        Codec40_reader *read - called for input
+        void *read_cl - closure passed to read
+        Codec40_writer *write - called with output
+        void *write_cl - closure passed to write
+
+        Once write takes fewer bytes than it is given, it is not called
+        again.
+
+    Returns: int - 0, EINVAL if codec, read or write is NULL or the input
+        is not a PPM, EBADMSG if the input is malformed, EIO if write does
+        not take all of the output, or the errno of a failure to make a
+        stream
+*/
+int Codec40_compress_callbacks (Codec40 codec, Codec40_reader *read, 
+        void *read_cl, Codec40_writer *write, void *write_cl);
+
+/* Codec40_decompress_callbacks
+    Purpose: Decompress a compressed image read through one callback,
+        writing the PPM through another.
+
+    Parameters: Same as Codec40_compress_callbacks.
+
+    Returns: Same as Codec40_compress_callbacks, with EINVAL if the input
+        is not a compressed image.
+*/
+int Codec40_decompress_callbacks (Codec40 codec, Codec40_reader *read, 
+        void *read_cl, Codec40_writer *write, void *write_cl);
+
+#endif
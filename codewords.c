@@ -12,11 +12,8 @@
 /* Maximum value of b,c,d from DCT */
 #define MAX_BCD (0.3)
 
-/* Used by mapping functions fill_codeword_list and fill_dct */
-struct Closure {
-    Seq_T list;
-    PackingScheme_T pc;
-};
+/* a, Pb and Pr are predicted from neighbouring blocks */
+#define PREDICTED_FIELDS 3
 
 /* double_to_int
     Purpose: convert a double to a signed integer, given the double's range.
@@ -87,36 +84,78 @@ double int_to_double (int64_t value, unsigned width, double maxval)
     return (double) value / newmax;
 }
 
-/* pack_codeword
-    Purpose: pack a DCT_Block into a 32-bit codeword according to a given
-        packing scheme.
+/* pack_fields
+    Purpose: pack already quantized codeword fields into a 32-bit codeword
+        according to a given packing scheme.
     
     Parameters:
-        DCT_Block block - discrete cosine transform block to pack
-        PackingScheme_T pc - how values of block should be stored
+        Codeword_Fields fields - quantized values to pack
+        PackingScheme_T pc - how values should be stored
 
     Returns: uint64_t - packed codeword
 */
-uint64_t pack_codeword (DCT_Block block, PackingScheme_T pc)
+uint64_t pack_fields (Codeword_Fields fields, PackingScheme_T pc)
 {
     uint64_t data = 0;
 
-    uint64_t a = double_to_uint(block.a, pc.a_width);
+    data = Bitpack_newu(data, pc.a_width, pc.a_lsb, fields.a);
 
-    int64_t b = double_to_int(block.b, pc.b_width, MAX_BCD);
-    int64_t c = double_to_int(block.c, pc.c_width, MAX_BCD);
-    int64_t d = double_to_int(block.d, pc.d_width, MAX_BCD);
+    data = Bitpack_news(data, pc.b_width, pc.b_lsb, fields.b);
+    data = Bitpack_news(data, pc.c_width, pc.c_lsb, fields.c);
+    data = Bitpack_news(data, pc.d_width, pc.d_lsb, fields.d);
 
-    data = Bitpack_newu(data, pc.a_width, pc.a_lsb, a);
+    data = Bitpack_newu(data, pc.pb_width, pc.pb_lsb, fields.pb_index);
+    data = Bitpack_newu(data, pc.pr_width, pc.pr_lsb, fields.pr_index);
 
-    data = Bitpack_news(data, pc.b_width, pc.b_lsb, b);
-    data = Bitpack_news(data, pc.c_width, pc.c_lsb, c);
-    data = Bitpack_news(data, pc.d_width, pc.d_lsb, d);
+    return data;
+}
 
-    data = Bitpack_newu(data, pc.pb_width, pc.pb_lsb, block.pb_index);
-    data = Bitpack_newu(data, pc.pr_width, pc.pr_lsb, block.pr_index);
+/* unpack_fields
+    Purpose: unpack a 32-bit codeword into its quantized fields according to
+        a given packing scheme.
+    
+    Parameters:
+        uint64_t codeword - codeword to unpack
+        PackingScheme_T pc - how the values are stored in the codeword 
 
-    return data;
+    Returns: Codeword_Fields - quantized values stored in the codeword
+*/
+Codeword_Fields unpack_fields (uint64_t codeword, PackingScheme_T pc)
+{
+    Codeword_Fields fields = {
+        .a = Bitpack_getu(codeword, pc.a_width, pc.a_lsb),
+        .b = Bitpack_gets(codeword, pc.b_width, pc.b_lsb),
+        .c = Bitpack_gets(codeword, pc.c_width, pc.c_lsb),
+        .d = Bitpack_gets(codeword, pc.d_width, pc.d_lsb),
+        .pb_index = Bitpack_getu(codeword, pc.pb_width, pc.pb_lsb),
+        .pr_index = Bitpack_getu(codeword, pc.pr_width, pc.pr_lsb)
+    };
+
+    return fields;
+}
+
+/* pack_codeword
+    Purpose: pack a DCT_Block into a 32-bit codeword according to a given
+        packing scheme.
+    
+    Parameters:
+        DCT_Block block - discrete cosine transform block to pack
+        PackingScheme_T pc - how values of block should be stored
+
+    Returns: uint64_t - packed codeword
+*/
+uint64_t pack_codeword (DCT_Block block, PackingScheme_T pc)
+{
+    Codeword_Fields fields = {
+        .a = double_to_uint(block.a, pc.a_width),
+        .b = double_to_int(block.b, pc.b_width, MAX_BCD),
+        .c = double_to_int(block.c, pc.c_width, MAX_BCD),
+        .d = double_to_int(block.d, pc.d_width, MAX_BCD),
+        .pb_index = block.pb_index,
+        .pr_index = block.pr_index
+    };
+
+    return pack_fields(fields, pc);
 }
 
 /* unpack_codeword
@@ -131,135 +170,186 @@ uint64_t pack_codeword (DCT_Block block, PackingScheme_T pc)
 */
 DCT_Block unpack_codeword (uint64_t codeword, PackingScheme_T pc)
 {
-    uint64_t a_int = Bitpack_getu(codeword, pc.a_width, pc.a_lsb);
-
-    int64_t b_int = Bitpack_gets(codeword, pc.b_width, pc.b_lsb);
-    int64_t c_int = Bitpack_gets(codeword, pc.c_width, pc.c_lsb);
-    int64_t d_int = Bitpack_gets(codeword, pc.d_width, pc.d_lsb);
-
-    uint64_t pb_index = Bitpack_getu(codeword, pc.pb_width, pc.pb_lsb);
-    uint64_t pr_index = Bitpack_getu(codeword, pc.pr_width, pc.pr_lsb);
-
-    double a = uint_to_double (a_int, pc.a_width);
-    double b = int_to_double (b_int, pc.b_width, MAX_BCD);
-    double c = int_to_double (c_int, pc.c_width, MAX_BCD);
-    double d = int_to_double (d_int, pc.d_width, MAX_BCD);
-
+    Codeword_Fields fields = unpack_fields(codeword, pc);
 
     DCT_Block block = {
-        .a = a, .b = b, .c = c, .d = d,
-        .pb_index = (unsigned) pb_index, .pr_index = (unsigned) pr_index
+        .a = uint_to_double(fields.a, pc.a_width),
+        .b = int_to_double(fields.b, pc.b_width, MAX_BCD),
+        .c = int_to_double(fields.c, pc.c_width, MAX_BCD),
+        .d = int_to_double(fields.d, pc.d_width, MAX_BCD),
+        .pb_index = fields.pb_index, .pr_index = fields.pr_index
     };
 
     return block;
 }
 
-/* fill_codeword_list
-    Purpose: Fill a Hanson sequence with codewords created from DCT_Blocks.
-        Apply function called by small_map_default in generate_codewords.
+/* field_mask
+    Purpose: get a mask of the bits a field takes in a codeword
 
-    Parameters: see A2Methods_smallapplyfun for more info
+    Parameters:
+        unsigned width - width of the field
+        unsigned lsb - position of the field's least significant bit
 
-    Errors: Throws an error if it cannot allocate memory
+    Returns: uint32_t - mask with the field's bits set
 */
-void fill_codeword_list (void *elem, void *cl)
+static inline uint32_t field_mask (unsigned width, unsigned lsb)
 {
-    struct Closure *clo = (struct Closure *) cl;
-
-    Seq_T list = (Seq_T) clo->list;
-
-    DCT_Block block = *(DCT_Block *) elem;
-
-    uint64_t *codeword = malloc(sizeof(*codeword));
-    assert(codeword != NULL);
-
-    *codeword = pack_codeword(block, clo->pc);
-
-    Seq_addhi(list, codeword);
+    return (uint32_t) ((((uint64_t) 1 << width) - 1) << lsb);
 }
 
-/* generate_codewords
-    Purpose: Given a 2D array of DCT_Blocks, pack each block into a codeword
-        and return a list of these codewords.
+/* med_predict
+    Purpose: predict a value from its left, upper and upper-left neighbours
+        with the median edge detector of LOCO-I: the smaller of left and
+        above when the corner is above both (an edge), the larger when it is
+        below both, and otherwise left + above - corner (a smooth plane)
 
     Parameters:
-        A2Methods_UArray2 array2 - 2D array of DCT_Blocks
-        A2Methods_T methods - methods that can operate on array2
-        PackingScheme_T pc - how values of each DCT_Block should be packed into
-            a 32-bit word
+        uint32_t left - value of the block to the left
+        uint32_t above - value of the block above
+        uint32_t corner - value of the block above and to the left
 
-    Returns: Seq_T - list of codewords
+    Returns: uint32_t - prediction, between left and above
 */
-Seq_T generate_codewords (A2Methods_UArray2 array2, A2Methods_T methods,
-    PackingScheme_T pc)
+static inline uint32_t med_predict (uint32_t left, uint32_t above, 
+    uint32_t corner)
 {
-    Seq_T codewords = Seq_new(0);
-
-    struct Closure cl = {.list = codewords, .pc = pc};
+    uint32_t low = left < above ? left : above;
+    uint32_t high = left < above ? above : left;
 
-    methods->small_map_default(array2, fill_codeword_list, &cl);
+    if (corner >= high) {
+        return low;
+    } else if (corner <= low) {
+        return high;
+    }
 
-    return codewords;
+    return left + above - corner;
 }
 
-/* fill_dct
-    Purpose: unpack a codeword and set element in a 2D array to the unpacked
-        DCT_Block. Called by small_map_default in generate_dct.
+/* predict_field
+    Purpose: predict one field of block (i, j) from its neighbours. The first
+        row is predicted from the left, the first column from above, and the
+        first block from 0.
 
-    Parameters: See A2Methods_smallapplyfun for more info.
+    Parameters:
+        uint32_t *codewords - array of codewords, stored row by row, whose
+            neighbours of block (i, j) hold their actual values
+        unsigned width - width of the array, in blocks
+        unsigned i - column of the block
+        unsigned j - row of the block
+        unsigned lsb - position of the field's least significant bit
+        uint32_t mask - field_mask of the field
+
+    Returns: uint32_t - prediction, in the field's position
 */
-void fill_dct (void *elem, void *cl)
+static inline uint32_t predict_field (uint32_t *codewords, unsigned width,
+    unsigned i, unsigned j, unsigned lsb, uint32_t mask)
 {
-    struct Closure *clo = (struct Closure *) cl;    
-
-    Seq_T list = (Seq_T) clo->list;
+    size_t k = (size_t) j * width + i;
 
-    uint64_t *codeword = (uint64_t *) Seq_remlo(list);
-
-    DCT_Block block = unpack_codeword(*codeword, clo->pc);
+    if (j == 0) {
+        return i == 0 ? 0 : codewords[k - 1] & mask;
+    } else if (i == 0) {
+        return codewords[k - width] & mask;
+    }
 
-    /* Since we've removed it, we'll free it here too */
-    free(codeword);
+    uint32_t left = (codewords[k - 1] & mask) >> lsb;
+    uint32_t above = (codewords[k - width] & mask) >> lsb;
+    uint32_t corner = (codewords[k - width - 1] & mask) >> lsb;
 
-    *(DCT_Block *) elem = block;
+    return med_predict(left, above, corner) << lsb;
 }
 
-/* generate_dct
-    Purpose: Given a sequence of codewords, unpack each one into a DCT_Block
-        and return a 2D array of these blocks.
+/* predict_codewords
+    Purpose: replace a, Pb and Pr of every codeword with its difference from
+        a prediction made from its left and upper neighbours, modulo the
+        field's width. b, c and d are left as they are. Smooth images give
+        residuals near zero, which entropy code into fewer bytes than the
+        values themselves.
 
     Parameters:
-        Seq_T codewords - list of codewords
-        A2Methods_T methods - methods to create and operate on a 2D array
-        PackingScheme_T pc - how values are stored in each codeword
-
-    Returns: A2Methods_UArray2 - 2D discrete cosine transform array
+        uint32_t *codewords - array of width * height codewords, stored row
+            by row, these values will be replaced with residuals
+        unsigned width - width of the array, in blocks
+        unsigned height - height of the array, in blocks
+        PackingScheme_T pc - where each field is stored in a codeword
 */
-A2Methods_UArray2 generate_dct (Seq_T codewords, A2Methods_T methods,
-    unsigned width, unsigned height, PackingScheme_T pc)
+void predict_codewords (uint32_t *codewords, unsigned width, 
+    unsigned height, PackingScheme_T pc)
 {
-    A2Methods_UArray2 dct = methods->new(width, height, 
-        sizeof(struct DCT_Block));
-
-    struct Closure cl = {.list = codewords, .pc = pc};
+    assert(codewords != NULL || (size_t) width * height == 0);
 
-    methods->small_map_default(dct, fill_dct, &cl);
+    unsigned lsbs[PREDICTED_FIELDS] = { pc.a_lsb, pc.pb_lsb, pc.pr_lsb };
+    uint32_t masks[PREDICTED_FIELDS] = {
+        field_mask(pc.a_width, pc.a_lsb),
+        field_mask(pc.pb_width, pc.pb_lsb),
+        field_mask(pc.pr_width, pc.pr_lsb)
+    };
 
-    return dct;
+    /* going backwards, every neighbour still holds its actual values when
+        a block is predicted */
+    size_t k = (size_t) width * height;
+    while (k-- > 0) {
+        unsigned i = k % width;
+        unsigned j = k / width;
+        uint32_t codeword = codewords[k];
+
+        int f;
+        for (f = 0; f < PREDICTED_FIELDS; f++) {
+            uint32_t prediction = predict_field(codewords, width, i, j, 
+                lsbs[f], masks[f]);
+            uint32_t residual = ((codeword & masks[f]) - prediction) & 
+                masks[f];
+
+            codeword = (codeword & ~masks[f]) | residual;
+        }
+
+        codewords[k] = codeword;
+    }
 }
 
-/* free_codeword_seq
-    Purpose: free each element in a codeword sequence, as well as the sequence
-        itself.
+/* unpredict_codewords
+    Purpose: undo predict_codewords, turning residuals of a, Pb and Pr back
+        into their values.
 
-    Parameters: Seq_T *list - pointer to Hanson sequence of codewords
+    Parameters:
+        uint32_t *codewords - array of width * height codewords, stored row
+            by row, holding residuals, these values will be replaced with
+            the actual codewords
+        unsigned width - width of the array, in blocks
+        unsigned height - height of the array, in blocks
+        PackingScheme_T pc - where each field is stored in a codeword
 */
-void free_codeword_seq (Seq_T *list)
+void unpredict_codewords (uint32_t *codewords, unsigned width, 
+    unsigned height, PackingScheme_T pc)
 {
-    int i;
-    for (i = 0; i < Seq_length(*list); i++) {
-        free(Seq_get(*list, i));
-    }
+    assert(codewords != NULL || (size_t) width * height == 0);
 
-    Seq_free(list);
-}
\ No newline at end of file
+    unsigned lsbs[PREDICTED_FIELDS] = { pc.a_lsb, pc.pb_lsb, pc.pr_lsb };
+    uint32_t masks[PREDICTED_FIELDS] = {
+        field_mask(pc.a_width, pc.a_lsb),
+        field_mask(pc.pb_width, pc.pb_lsb),
+        field_mask(pc.pr_width, pc.pr_lsb)
+    };
+
+    /* going forwards, every neighbour has already been restored when a
+        block is predicted */
+    unsigned i, j;
+    size_t k = 0;
+    for (j = 0; j < height; j++) {
+        for (i = 0; i < width; i++, k++) {
+            uint32_t codeword = codewords[k];
+
+            int f;
+            for (f = 0; f < PREDICTED_FIELDS; f++) {
+                uint32_t prediction = predict_field(codewords, width, i, j,
+                    lsbs[f], masks[f]);
+                uint32_t value = ((codeword & masks[f]) + prediction) & 
+                    masks[f];
+
+                codeword = (codeword & ~masks[f]) | value;
+            }
+
+            codewords[k] = codeword;
+        }
+    }
+}
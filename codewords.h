@@ -2,21 +2,20 @@
    codewords.c
    Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
    Date: 27 October 2021
-   Purpose: Interface for packing a discrete cosine transformed image into a
-       list 32-bit codewords (one per block), and for unpacking a list of 
-       codewords into a discrete cosine transformed image.
+   Purpose: Interface for packing a discrete cosine transformed image into an
+       array of 32-bit codewords (one per block), and for unpacking an array
+       of codewords into a discrete cosine transformed image.
 */
 #ifndef CODEWORDS_INCLUDED
 #define CODEWORDS_INCLUDED
 
 #include <stdint.h>
 #include <math.h>
-#include <seq.h>
-#include <a2methods.h>
 #include <assert.h>
 
 #include "dct.h"
 #include "bitpack.h"
+#include "options.h"
 
 /* PackingScheme_T describes how each value from a DCT_Block should be
         stored in a 32-bit codeword. */
@@ -29,41 +28,95 @@ typedef struct PackingScheme {
         unsigned pr_width, pr_lsb;
 } PackingScheme_T;
 
-/* generate_codewords
-    Purpose: Given a 2D array of DCT_Blocks, pack each block into a codeword
-        and return a list of these codewords.
+/* Defined in compress40.c and used wherever codewords are packed or
+        unpacked */
+extern PackingScheme_T packingscheme;
 
+/* Codeword_Fields holds the quantized values stored in a codeword, before
+        they are turned back into doubles */
+typedef struct Codeword_Fields {
+        uint64_t a;
+        int64_t b, c, d;
+        unsigned pb_index, pr_index;
+} Codeword_Fields;
+
+/* pack_fields
+    Purpose: pack already quantized codeword fields into a 32-bit codeword
+        according to a given packing scheme.
+    
     Parameters:
-        A2Methods_UArray2 array2 - 2D array of DCT_Blocks
-        A2Methods_T methods - methods that can operate on array2
-        PackingScheme_T pc - how values of each DCT_Block should be packed into
-            a 32-bit word
+        Codeword_Fields fields - quantized values to pack
+        PackingScheme_T pc - how values should be stored
 
-    Returns: Seq_T - list of codewords
+    Returns: uint64_t - packed codeword
 */
-Seq_T generate_codewords (A2Methods_UArray2 array2, A2Methods_T methods,
-        PackingScheme_T pc);
+uint64_t pack_fields (Codeword_Fields fields, PackingScheme_T pc);
+
+/* unpack_fields
+    Purpose: unpack a 32-bit codeword into its quantized fields according to
+        a given packing scheme.
+    
+    Parameters:
+        uint64_t codeword - codeword to unpack
+        PackingScheme_T pc - how the values are stored in the codeword 
 
-/* generate_dct
-    Purpose: Given a sequence of codewords, unpack each one into a DCT_Block
-        and return a 2D array of these blocks.
+    Returns: Codeword_Fields - quantized values stored in the codeword
+*/
+Codeword_Fields unpack_fields (uint64_t codeword, PackingScheme_T pc);
 
+/* pack_codeword
+    Purpose: pack a DCT_Block into a 32-bit codeword according to a given
+        packing scheme.
+    
     Parameters:
-        Seq_T codewords - list of codewords
-        A2Methods_T methods - methods to create and operate on a 2D array
-        PackingScheme_T pc - how values are stored in each codeword
+        DCT_Block block - discrete cosine transform block to pack
+        PackingScheme_T pc - how values of block should be stored
 
-    Returns: A2Methods_UArray2 - 2D discrete cosine transform array
+    Returns: uint64_t - packed codeword
 */
-A2Methods_UArray2 generate_dct (Seq_T codewords, A2Methods_T methods, 
-                unsigned width, unsigned height, PackingScheme_T pc);
+uint64_t pack_codeword (DCT_Block block, PackingScheme_T pc);
 
-/* free_codeword_seq
-    Purpose: free each element in a codeword sequence, as well as the sequence
-        itself.
+/* unpack_codeword
+    Purpose: unpack a 32-bit codeword into a DCT_Block according to a given
+        packing scheme.
+    
+    Parameters:
+        uint64_t codeword - codeword to unpack
+        PackingScheme_T pc - how the values are stored in the codeword 
+
+    Returns: DCT_Block - unpacked discrete cosine transform
+*/
+DCT_Block unpack_codeword (uint64_t codeword, PackingScheme_T pc);
 
-    Parameters: Seq_T *list - pointer to Hanson sequence of codewords
+/* predict_codewords
+    Purpose: replace a, Pb and Pr of every codeword with its difference from
+        a MED (LOCO-I) prediction made from its left and upper neighbours,
+        modulo the field's width. Codewords keep their size; the residuals
+        are smaller to entropy code.
+
+    Parameters:
+        uint32_t *codewords - array of width * height codewords, stored row
+            by row, these values will be replaced with residuals
+        unsigned width - width of the array, in blocks
+        unsigned height - height of the array, in blocks
+        PackingScheme_T pc - where each field is stored in a codeword
+*/
+void predict_codewords (uint32_t *codewords, unsigned width, 
+        unsigned height, PackingScheme_T pc);
+
+/* unpredict_codewords
+    Purpose: undo predict_codewords, turning residuals of a, Pb and Pr back
+        into their values.
+
+    Parameters:
+        uint32_t *codewords - array of width * height codewords, stored row
+            by row, holding residuals, these values will be replaced with
+            the actual codewords
+        unsigned width - width of the array, in blocks
+        unsigned height - height of the array, in blocks
+        PackingScheme_T pc - where each field is stored in a codeword
 */
-void free_codeword_seq (Seq_T *list);
+void unpredict_codewords (uint32_t *codewords, unsigned width, 
+        unsigned height, PackingScheme_T pc);
 
 #endif
\ No newline at end of file
@@ -7,14 +7,16 @@
 */
 #include "color_conversion.h"
 
-#define COMPRESS_BLOCK_WIDTH 2
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS 1
+#endif
 
-/* Passed into convert_to_scaled_rgb */
-struct Small_Closure {
-    int denominator;
-    A2Methods_T methods;
-    A2Methods_UArray2 array2;
-};
+/* Number of pixels converted by each pass of the AVX2 loops: two vectors of
+    four doubles. Rows of blocks are converted this many pixels of both
+    scanlines, or AVX2_BLOCKS blocks, at a time. */
+#define AVX2_STRIDE 8
+#define AVX2_BLOCKS (AVX2_STRIDE / 2)
 
 /* rgb_to_cv
     Purpose: Convert rgb values to component video and return the resulting
@@ -27,7 +29,7 @@ struct Small_Closure {
     
     Returns: CV_Pixel - converted pixel
 */
-CV_Pixel rgb_to_cv (double r, double g, double b)
+static CV_Pixel rgb_to_cv (double r, double g, double b)
 {
     double y = 0.299 * r + 0.587 * g + 0.114 * b;
     double pb = -0.168736 * r - 0.331264 * g + 0.5 * b;
@@ -38,6 +40,414 @@ CV_Pixel rgb_to_cv (double r, double g, double b)
     return cv_pix;
 }
 
+/* pixel_to_cv
+    Purpose: Scale a Pnm_rgb pixel by its image's denominator and convert it
+        to component video.
+
+    Parameters:
+        Pnm_rgb pixel - pixel to convert
+        unsigned denominator - denominator of the image the pixel belongs to
+
+    Returns: CV_Pixel - converted pixel
+*/
+CV_Pixel pixel_to_cv (Pnm_rgb pixel, unsigned denominator)
+{
+    double r = (double) pixel->red / denominator;
+    double g = (double) pixel->green / denominator;
+    double b = (double) pixel->blue / denominator;
+
+    return rgb_to_cv(r, g, b);
+}
+
+/* planes_from
+    Purpose: get the planes of a row of blocks starting at a given block, so
+        that the rest of a row can be converted on its own.
+
+    Parameters:
+        CV_Planes *planes - planes of the whole row
+        unsigned col - index of the first block
+
+    Returns: CV_Planes - planes starting at block col
+*/
+static inline CV_Planes planes_from (CV_Planes *planes, unsigned col)
+{
+    CV_Planes rest = {
+        .top_y = &planes->top_y[2 * col],
+        .bottom_y = &planes->bottom_y[2 * col],
+        .pb = &planes->pb[col],
+        .pr = &planes->pr[col]
+    };
+
+    return rest;
+}
+
+/* store_block_cv
+    Purpose: Store the component video of one 2x2 block in the planes of its
+        row: the luminance of every pixel, and the average Pb and Pr of the
+        four pixels, rounded to floats.
+
+    Parameters:
+        CV_Pixel pix1 - top-left component video pixel
+        CV_Pixel pix2 - top-right component video pixel
+        CV_Pixel pix3 - bottom-left component video pixel
+        CV_Pixel pix4 - bottom-right component video pixel
+        CV_Planes *planes - planes of the row, these values will be set
+        unsigned col - index of the block in the row
+*/
+static inline void store_block_cv (CV_Pixel pix1, CV_Pixel pix2, 
+    CV_Pixel pix3, CV_Pixel pix4, CV_Planes *planes, unsigned col)
+{
+    planes->top_y[2 * col] = pix1.y;
+    planes->top_y[2 * col + 1] = pix2.y;
+    planes->bottom_y[2 * col] = pix3.y;
+    planes->bottom_y[2 * col + 1] = pix4.y;
+
+    planes->pb[col] = (pix1.pb + pix2.pb + pix3.pb + pix4.pb) / 4.0;
+    planes->pr[col] = (pix1.pr + pix2.pr + pix3.pr + pix4.pr) / 4.0;
+}
+
+/* rgb_row_to_cv_scalar
+    Purpose: Convert a row of blocks of Pnm_rgb pixels to component video
+        one block at a time. Used when AVX2 is not available, and for the
+        blocks left over at the end of a row by rgb_row_to_cv_avx2.
+
+    Parameters: See rgb_row_to_cv for more info.
+*/
+static void rgb_row_to_cv_scalar (struct Pnm_rgb *top, 
+    struct Pnm_rgb *bottom, unsigned blocks, unsigned denominator, 
+    CV_Planes *planes)
+{
+    unsigned col;
+    for (col = 0; col < blocks; col++) {
+        unsigned l = 2 * col;
+
+        store_block_cv(pixel_to_cv(&top[l], denominator),
+            pixel_to_cv(&top[l + 1], denominator),
+            pixel_to_cv(&bottom[l], denominator),
+            pixel_to_cv(&bottom[l + 1], denominator), planes, col);
+    }
+}
+
+#ifdef HAVE_AVX2_KERNELS
+
+/* Component video of four pixels, one per lane */
+struct CV_Quad {
+    __m256d y, pb, pr;
+};
+
+/* cv_quad_avx2
+    Purpose: Convert four RGB pixels to component video at once. Each
+        multiply and add is done separately, in the same order as rgb_to_cv,
+        so that the results are bit-for-bit the same as the scalar code.
+
+    Parameters:
+        __m128i red - red values of the four pixels, one per 32-bit lane
+        __m128i green - green values of the four pixels
+        __m128i blue - blue values of the four pixels
+        __m256d denominator - denominator of the image in every lane
+
+    Returns: struct CV_Quad - the four converted pixels
+*/
+__attribute__((target("avx2")))
+static inline struct CV_Quad cv_quad_avx2 (__m128i red, __m128i green, 
+    __m128i blue, __m256d denominator)
+{
+    __m256d r = _mm256_div_pd(_mm256_cvtepi32_pd(red), denominator);
+    __m256d g = _mm256_div_pd(_mm256_cvtepi32_pd(green), denominator);
+    __m256d b = _mm256_div_pd(_mm256_cvtepi32_pd(blue), denominator);
+
+    struct CV_Quad quad;
+
+    quad.y = _mm256_add_pd(_mm256_add_pd(
+        _mm256_mul_pd(_mm256_set1_pd(0.299), r),
+        _mm256_mul_pd(_mm256_set1_pd(0.587), g)),
+        _mm256_mul_pd(_mm256_set1_pd(0.114), b));
+
+    quad.pb = _mm256_add_pd(_mm256_sub_pd(
+        _mm256_mul_pd(_mm256_set1_pd(-0.168736), r),
+        _mm256_mul_pd(_mm256_set1_pd(0.331264), g)),
+        _mm256_mul_pd(_mm256_set1_pd(0.5), b));
+
+    quad.pr = _mm256_sub_pd(_mm256_sub_pd(
+        _mm256_mul_pd(_mm256_set1_pd(0.5), r),
+        _mm256_mul_pd(_mm256_set1_pd(0.418688), g)),
+        _mm256_mul_pd(_mm256_set1_pd(0.081312), b));
+
+    return quad;
+}
+
+/* rgb_quad_to_cv_avx2
+    Purpose: Convert four Pnm_rgb pixels to component video at once.
+
+    Parameters:
+        struct Pnm_rgb *row - first of the four pixels
+        __m256d denominator - denominator of the image in every lane
+
+    Returns: struct CV_Quad - the four converted pixels
+*/
+__attribute__((target("avx2")))
+static inline struct CV_Quad rgb_quad_to_cv_avx2 (struct Pnm_rgb *row,
+    __m256d denominator)
+{
+    /* A Pnm_rgb is three unsigneds, so the reds of four pixels are three
+        ints apart, with green and blue just after them */
+    const __m128i stride = _mm_setr_epi32(0, 3, 6, 9);
+    const int *base = (const int *) row;
+
+    return cv_quad_avx2(_mm_i32gather_epi32(base, stride, 4),
+        _mm_i32gather_epi32(base + 1, stride, 4),
+        _mm_i32gather_epi32(base + 2, stride, 4),
+        denominator);
+}
+
+/* packed_quad_to_cv_avx2
+    Purpose: Convert four pixels of packed 8-bit RGB to component video at
+        once. Reads 16 bytes, four more than the pixels take up.
+
+    Parameters:
+        unsigned char *row - first byte of the four pixels
+        __m256d denominator - denominator of the image in every lane
+
+    Returns: struct CV_Quad - the four converted pixels
+*/
+__attribute__((target("avx2")))
+static inline struct CV_Quad packed_quad_to_cv_avx2 (unsigned char *row,
+    __m256d denominator)
+{
+    /* spread every third byte into its own 32-bit lane */
+    const __m128i reds = _mm_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1,
+        6, -1, -1, -1, 9, -1, -1, -1);
+    const __m128i greens = _mm_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1,
+        7, -1, -1, -1, 10, -1, -1, -1);
+    const __m128i blues = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1,
+        8, -1, -1, -1, 11, -1, -1, -1);
+
+    __m128i bytes = _mm_loadu_si128((__m128i *) row);
+
+    return cv_quad_avx2(_mm_shuffle_epi8(bytes, reds),
+        _mm_shuffle_epi8(bytes, greens),
+        _mm_shuffle_epi8(bytes, blues),
+        denominator);
+}
+
+/* average_chroma_avx2
+    Purpose: Average the Pb or Pr values of four 2x2 blocks at once, adding
+        each block's pixels in the same order as store_block_cv so that the
+        results are bit-for-bit the same as the scalar code.
+
+    Parameters:
+        __m256d top0 - chromas of the upper scanline's first four pixels
+        __m256d top1 - chromas of the upper scanline's next four pixels
+        __m256d bottom0 - chromas of the lower scanline's first four pixels
+        __m256d bottom1 - chromas of the lower scanline's next four pixels
+
+    Returns: __m128 - the four blocks' average chromas, as floats
+*/
+__attribute__((target("avx2")))
+static inline __m128 average_chroma_avx2 (__m256d top0, __m256d top1,
+    __m256d bottom0, __m256d bottom1)
+{
+    /* Unpacking gathers the left and the right pixels of blocks 0, 2, 1
+        and 3, in that order */
+    __m256d top_left = _mm256_unpacklo_pd(top0, top1);
+    __m256d top_right = _mm256_unpackhi_pd(top0, top1);
+    __m256d bottom_left = _mm256_unpacklo_pd(bottom0, bottom1);
+    __m256d bottom_right = _mm256_unpackhi_pd(bottom0, bottom1);
+
+    __m256d sum = _mm256_add_pd(_mm256_add_pd(
+        _mm256_add_pd(top_left, top_right), bottom_left), bottom_right);
+
+    /* put the blocks back in order: lanes 0, 2, 1, 3 */
+    sum = _mm256_permute4x64_pd(sum, 0xD8);
+
+    return _mm256_cvtpd_ps(_mm256_div_pd(sum, _mm256_set1_pd(4.0)));
+}
+
+/* store_blocks_avx2
+    Purpose: Store the component video of four 2x2 blocks in the planes of
+        their row, like store_block_cv does for one.
+
+    Parameters:
+        struct CV_Quad top0 - the upper scanline's first four pixels
+        struct CV_Quad top1 - the upper scanline's next four pixels
+        struct CV_Quad bottom0 - the lower scanline's first four pixels
+        struct CV_Quad bottom1 - the lower scanline's next four pixels
+        CV_Planes *planes - planes of the row, these values will be set
+        unsigned col - index of the first block in the row
+*/
+__attribute__((target("avx2")))
+static inline void store_blocks_avx2 (struct CV_Quad top0, 
+    struct CV_Quad top1, struct CV_Quad bottom0, struct CV_Quad bottom1,
+    CV_Planes *planes, unsigned col)
+{
+    _mm256_storeu_pd(&planes->top_y[2 * col], top0.y);
+    _mm256_storeu_pd(&planes->top_y[2 * col + 4], top1.y);
+    _mm256_storeu_pd(&planes->bottom_y[2 * col], bottom0.y);
+    _mm256_storeu_pd(&planes->bottom_y[2 * col + 4], bottom1.y);
+
+    _mm_storeu_ps(&planes->pb[col], 
+        average_chroma_avx2(top0.pb, top1.pb, bottom0.pb, bottom1.pb));
+    _mm_storeu_ps(&planes->pr[col], 
+        average_chroma_avx2(top0.pr, top1.pr, bottom0.pr, bottom1.pr));
+}
+
+/* rgb_row_to_cv_avx2
+    Purpose: Convert a row of blocks of Pnm_rgb pixels to component video
+        four blocks at a time using AVX2.
+
+    Parameters: See rgb_row_to_cv for more info.
+*/
+__attribute__((target("avx2")))
+static void rgb_row_to_cv_avx2 (struct Pnm_rgb *top, struct Pnm_rgb *bottom,
+    unsigned blocks, unsigned denominator, CV_Planes *planes)
+{
+    __m256d denom = _mm256_set1_pd((double) denominator);
+
+    unsigned col;
+    for (col = 0; col + AVX2_BLOCKS <= blocks; col += AVX2_BLOCKS) {
+        unsigned l = 2 * col;
+
+        store_blocks_avx2(rgb_quad_to_cv_avx2(&top[l], denom),
+            rgb_quad_to_cv_avx2(&top[l + 4], denom),
+            rgb_quad_to_cv_avx2(&bottom[l], denom),
+            rgb_quad_to_cv_avx2(&bottom[l + 4], denom), planes, col);
+    }
+
+    CV_Planes rest = planes_from(planes, col);
+    rgb_row_to_cv_scalar(&top[2 * col], &bottom[2 * col], blocks - col, 
+        denominator, &rest);
+}
+
+#endif
+
+/* rgb_row_to_cv
+    Purpose: Convert a row of 2x2 blocks of Pnm_rgb pixels, given as its two
+        scanlines, to component video planes. Each block's Pb and Pr are the
+        averages of its four pixels'. Uses AVX2 when the processor has it;
+        the results are the same either way.
+
+    Parameters:
+        struct Pnm_rgb *top - upper scanline of at least 2 * blocks pixels
+        struct Pnm_rgb *bottom - lower scanline of at least 2 * blocks
+            pixels
+        unsigned blocks - number of blocks to convert
+        unsigned denominator - denominator of the image the pixels belong to
+        CV_Planes *planes - planes with room for blocks blocks, these values
+            will be set
+*/
+void rgb_row_to_cv (struct Pnm_rgb *top, struct Pnm_rgb *bottom, 
+    unsigned blocks, unsigned denominator, CV_Planes *planes)
+{
+#ifdef HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2")) {
+        rgb_row_to_cv_avx2(top, bottom, blocks, denominator, planes);
+        return;
+    }
+#endif
+
+    rgb_row_to_cv_scalar(top, bottom, blocks, denominator, planes);
+}
+
+/* packed_pixel_to_cv
+    Purpose: Scale a pixel of packed 8-bit RGB by its image's denominator
+        and convert it to component video.
+
+    Parameters:
+        unsigned char *pixel - the pixel's three bytes
+        unsigned denominator - denominator of the image
+
+    Returns: CV_Pixel - converted pixel
+*/
+static inline CV_Pixel packed_pixel_to_cv (unsigned char *pixel, 
+    unsigned denominator)
+{
+    return rgb_to_cv((double) pixel[0] / denominator,
+        (double) pixel[1] / denominator,
+        (double) pixel[2] / denominator);
+}
+
+/* packed_row_to_cv_scalar
+    Purpose: Convert a row of blocks of packed 8-bit RGB pixels to component
+        video one block at a time. Used when AVX2 is not available, and for
+        the blocks left over at the end of a row by packed_row_to_cv_avx2.
+
+    Parameters: See packed_row_to_cv for more info.
+*/
+static void packed_row_to_cv_scalar (unsigned char *top, 
+    unsigned char *bottom, unsigned blocks, unsigned denominator, 
+    CV_Planes *planes)
+{
+    unsigned col;
+    for (col = 0; col < blocks; col++) {
+        unsigned l = 6 * col;
+
+        store_block_cv(packed_pixel_to_cv(&top[l], denominator),
+            packed_pixel_to_cv(&top[l + 3], denominator),
+            packed_pixel_to_cv(&bottom[l], denominator),
+            packed_pixel_to_cv(&bottom[l + 3], denominator), planes, col);
+    }
+}
+
+#ifdef HAVE_AVX2_KERNELS
+
+/* packed_row_to_cv_avx2
+    Purpose: Convert a row of blocks of packed 8-bit RGB pixels to component
+        video four blocks at a time using AVX2. The last load of each
+        scanline in a pass reads four bytes past the pass's pixels, so the
+        vector loop stops while at least one more block is left and never
+        reads past the row.
+
+    Parameters: See packed_row_to_cv for more info.
+*/
+__attribute__((target("avx2")))
+static void packed_row_to_cv_avx2 (unsigned char *top, unsigned char *bottom,
+    unsigned blocks, unsigned denominator, CV_Planes *planes)
+{
+    __m256d denom = _mm256_set1_pd((double) denominator);
+
+    unsigned col;
+    for (col = 0; col + AVX2_BLOCKS + 1 <= blocks; col += AVX2_BLOCKS) {
+        unsigned l = 6 * col;
+
+        store_blocks_avx2(packed_quad_to_cv_avx2(&top[l], denom),
+            packed_quad_to_cv_avx2(&top[l + 12], denom),
+            packed_quad_to_cv_avx2(&bottom[l], denom),
+            packed_quad_to_cv_avx2(&bottom[l + 12], denom), planes, col);
+    }
+
+    CV_Planes rest = planes_from(planes, col);
+    packed_row_to_cv_scalar(&top[6 * col], &bottom[6 * col], blocks - col, 
+        denominator, &rest);
+}
+
+#endif
+
+/* packed_row_to_cv
+    Purpose: Convert a row of 2x2 blocks of packed 8-bit RGB pixels, as
+        stored in a raw PPM, to component video planes. Gives the same
+        results as rgb_row_to_cv on the same pixels.
+
+    Parameters:
+        unsigned char *top - upper scanline of at least 6 * blocks bytes
+        unsigned char *bottom - lower scanline of at least 6 * blocks bytes
+        unsigned blocks - number of blocks to convert
+        unsigned denominator - denominator of the image, less than 256
+        CV_Planes *planes - planes with room for blocks blocks, these values
+            will be set
+*/
+void packed_row_to_cv (unsigned char *top, unsigned char *bottom, 
+    unsigned blocks, unsigned denominator, CV_Planes *planes)
+{
+#ifdef HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2")) {
+        packed_row_to_cv_avx2(top, bottom, blocks, denominator, planes);
+        return;
+    }
+#endif
+
+    packed_row_to_cv_scalar(top, bottom, blocks, denominator, planes);
+}
+
 /* clamp_value_01
     Purpose: make sure a value does not go below 0 or exceed 1
 
@@ -45,7 +455,7 @@ CV_Pixel rgb_to_cv (double r, double g, double b)
 
     Returns: double - clamped value
 */
-double clamp_value_01 (double value) {
+static double clamp_value_01 (double value) {
     if (value < 0) {
         return 0;
     }
@@ -87,177 +497,181 @@ struct Pnm_rgb cv_to_rgb (CV_Pixel cv_pix, int denominator)
     return rgb_pix;
 }
 
-/* convert_to_component_video
-    Purpose: Convert a pixel from a Pnm_ppm to a component video pixel and 
-        store it in its corresponding position in the UArray2. Called by
-        map_default in create_component_video
+/* cv_row_to_rgb_scalar
+    Purpose: Convert a scanline of component video to packed 8-bit RGB one
+        pixel at a time. Used when AVX2 is not available, and for the pixels
+        left over at the end of a scanline by cv_row_to_rgb_avx2.
 
-    Parameters: See A2Methods_applyfun for more info.  
+    Parameters: See cv_row_to_rgb for more info.
 */
-void convert_to_component_video (int i, int j,
-    A2Methods_UArray2 array2, void *elem, 
-    void *cl)
+static void cv_row_to_rgb_scalar (double *y, float *pb, float *pr,
+    unsigned length, unsigned pixels_per_chroma, int denominator, 
+    unsigned char *rgb)
 {
-    (void) elem;
-    (void) array2;
-
-    Pnm_ppm image = (Pnm_ppm) cl;
+    unsigned i;
+    for (i = 0; i < length; i++) {
+        unsigned k = i / pixels_per_chroma;
 
-    Pnm_rgb pixel = image->methods->at(image->pixels, i, j);
+        CV_Pixel cv_pix = { .y = y[i], .pb = pb[k], .pr = pr[k] };
+        struct Pnm_rgb pixel = cv_to_rgb(cv_pix, denominator);
 
-    double r = (double) pixel->red / image->denominator;
-    double g = (double) pixel->green / image->denominator;
-    double b = (double) pixel->blue / image-> denominator;
-
-    CV_Pixel cv_pix = rgb_to_cv(r, g, b);
-
-    *(CV_Pixel *) elem = cv_pix;
+        rgb[3 * i] = pixel.red;
+        rgb[3 * i + 1] = pixel.green;
+        rgb[3 * i + 2] = pixel.blue;
+    }
 }
 
-/* convert_to_scaled_rgb
-    Purpose: Convert a component video pixel to a pixel from a Pnm_ppm and
-        store it in its corresponding position in the Pnm_ppm. Called by
-        map_default in create_scaled_rgb
-
-    Parameters: See A2Methods_applyfun for more info.  
-
-    Errors: Throws an error if cannot allcate memory
-*/
-void convert_to_scaled_rgb (int i, int j,
-    A2Methods_UArray2 array2, void *elem, 
-    void *cl)
-{
-    (void) elem;
-    (void) array2;
-
-    struct Small_Closure scl = *(struct Small_Closure *) cl;
+#ifdef HAVE_AVX2_KERNELS
 
-    CV_Pixel cv_pix = *(CV_Pixel *) scl.methods->at(scl.array2, i, j);
+/* load_chroma_avx2
+    Purpose: Load the Pb or Pr values of four pixels as doubles, from a
+        plane with one value for every pixels_per_chroma pixels.
 
-    Pnm_rgb pixel = malloc(sizeof(*pixel));
-    assert(pixel != NULL);
-
-    *pixel = cv_to_rgb(cv_pix, scl.denominator);
-
-    memcpy(elem, pixel, sizeof(*pixel));
-
-    free(pixel);
-}
-
-/* average_chroma
-    Purpose: for each 2x2 block of pixels, average the Pb and Pr values and
-        store these quantized values in the pixels. Called by map_default in
-        create_component_video.
+    Parameters:
+        float *chroma - value of the first pixel
+        unsigned pixels_per_chroma - 1 or 2
 
-    Parameters: See A2Methods_applyfun for more info.
+    Returns: __m256d - the four pixels' values
 */
-void average_chroma (int i, int j,
-    A2Methods_UArray2 array2, void *elem, 
-    void *cl)
+__attribute__((target("avx2")))
+static inline __m256d load_chroma_avx2 (float *chroma, 
+    unsigned pixels_per_chroma)
 {
-    /* The bottom-right pixel of a 2x2 block will have odd column and row
-        indices */
-    if (!(i % 2 == 1 && j % 2 == 1)) {
-        return;
+    if (pixels_per_chroma == 1) {
+        return _mm256_cvtps_pd(_mm_loadu_ps(chroma));
     }
 
-    A2Methods_T methods = (A2Methods_T) cl;
-
-    CV_Pixel *pix1 = (CV_Pixel *) methods->at(array2, i-1, j-1);
-    CV_Pixel *pix2 = (CV_Pixel *) methods->at(array2, i, j-1);
-    CV_Pixel *pix3 = (CV_Pixel *) methods->at(array2, i-1, j);
-    CV_Pixel *pix4 = (CV_Pixel *) elem;
-
-    float avg_pr = (pix1->pr + pix2->pr + pix3->pr + pix4->pr) / 4.0;
-    float avg_pb = (pix1->pb + pix2->pb + pix3->pb + pix4->pb) / 4.0;
-
-    unsigned pr_index = Arith40_index_of_chroma(avg_pr);
-    unsigned pb_index = Arith40_index_of_chroma(avg_pb);
-
-    pix1->pb_index = pb_index;
-    pix1->pr_index = pr_index;
-
-    pix2->pb_index = pb_index;
-    pix2->pr_index = pr_index;
-
-    pix3->pb_index = pb_index;
-    pix3->pr_index = pr_index;
-
-    pix4->pb_index = pb_index;
-    pix4->pr_index = pr_index;
+    /* two values, each repeated for the two pixels of its block */
+    __m128 pair = _mm_castsi128_ps(_mm_loadl_epi64((__m128i *) chroma));
+    return _mm256_cvtps_pd(_mm_unpacklo_ps(pair, pair));
 }
 
-/* create_component_video
-    Purpose: Create a 2D array of component video pixels from a Pnm_ppm.
+/* cv_quad_to_rgb_avx2
+    Purpose: Convert four component video pixels to scaled RGB at once and
+        store them as 12 packed bytes. Each multiply and add is done
+        separately, in the same order as cv_to_rgb, and clamping and
+        truncation match clamp_value_01 and the cast to unsigned, so that the
+        results are bit-for-bit the same as the scalar code.
 
     Parameters:
-        Pnm_ppm image - image to create component video array from
-        A2Methods_T methods - methods to create and operate on 2D array
-
-    Returns: A2Methods_UArray2 - array of component video. It is a blocked
-        array with each block storing a 2x2 chunk of pixels
+        double *y - four luminances
+        __m256d pbv - the four pixels' Pb values
+        __m256d prv - the four pixels' Pr values
+        __m256d denominator - value to scale RGB values by, in every lane
+        unsigned char *rgb - where to store the 12 bytes
 */
-A2Methods_UArray2 create_component_video (Pnm_ppm image, A2Methods_T methods)
+__attribute__((target("avx2")))
+static inline void cv_quad_to_rgb_avx2 (double *y, __m256d pbv, __m256d prv,
+    __m256d denominator, unsigned char *rgb)
 {
-    assert(image != NULL);
-    assert(methods != NULL);
-
-    A2Methods_UArray2 component_video = methods->new(
-        image->width, image->height,
-        sizeof(CV_Pixel)
-    );
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    __m256d yv = _mm256_loadu_pd(y);
+
+    __m256d r = _mm256_add_pd(_mm256_add_pd(
+        _mm256_mul_pd(one, yv),
+        _mm256_mul_pd(zero, pbv)),
+        _mm256_mul_pd(_mm256_set1_pd(1.402), prv));
+
+    __m256d g = _mm256_sub_pd(_mm256_sub_pd(
+        _mm256_mul_pd(one, yv),
+        _mm256_mul_pd(_mm256_set1_pd(0.344136), pbv)),
+        _mm256_mul_pd(_mm256_set1_pd(0.714136), prv));
+
+    __m256d b = _mm256_add_pd(_mm256_add_pd(
+        _mm256_mul_pd(one, yv),
+        _mm256_mul_pd(_mm256_set1_pd(1.772), pbv)),
+        _mm256_mul_pd(zero, prv));
+
+    r = _mm256_mul_pd(_mm256_min_pd(_mm256_max_pd(r, zero), one), 
+        denominator);
+    g = _mm256_mul_pd(_mm256_min_pd(_mm256_max_pd(g, zero), one), 
+        denominator);
+    b = _mm256_mul_pd(_mm256_min_pd(_mm256_max_pd(b, zero), one), 
+        denominator);
+
+    /* Truncate to integers, narrow to bytes laid out as rrrrggggbbbb, then
+        shuffle them into rgbrgbrgbrgb order */
+    __m128i rg = _mm_packs_epi32(_mm256_cvttpd_epi32(r), 
+        _mm256_cvttpd_epi32(g));
+    __m128i bb = _mm_packs_epi32(_mm256_cvttpd_epi32(b), _mm_setzero_si128());
+    __m128i bytes = _mm_packus_epi16(rg, bb);
+
+    const __m128i interleave = _mm_setr_epi8(0, 4, 8, 1, 5, 9, 2, 6, 10,
+        3, 7, 11, 12, 13, 14, 15);
+    bytes = _mm_shuffle_epi8(bytes, interleave);
+
+    _mm_storel_epi64((__m128i *) rgb, bytes);
+
+    int last = _mm_extract_epi32(bytes, 2);
+    memcpy(rgb + 8, &last, 4);
+}
 
-    methods->map_default(component_video, 
-        convert_to_component_video, image);
+/* cv_row_to_rgb_avx2
+    Purpose: Convert a scanline of component video to packed 8-bit RGB
+        eight pixels at a time using AVX2.
 
-    methods->map_default(component_video, average_chroma, 
-        methods);
+    Parameters: See cv_row_to_rgb for more info.
+*/
+__attribute__((target("avx2")))
+static void cv_row_to_rgb_avx2 (double *y, float *pb, float *pr,
+    unsigned length, unsigned pixels_per_chroma, int denominator, 
+    unsigned char *rgb)
+{
+    __m256d denom = _mm256_set1_pd((double) denominator);
+
+    unsigned i;
+    for (i = 0; i + AVX2_STRIDE <= length; i += AVX2_STRIDE) {
+        unsigned k = i / pixels_per_chroma;
+        unsigned k4 = (i + 4) / pixels_per_chroma;
+
+        cv_quad_to_rgb_avx2(&y[i], load_chroma_avx2(&pb[k], pixels_per_chroma),
+            load_chroma_avx2(&pr[k], pixels_per_chroma), denom, &rgb[3 * i]);
+        cv_quad_to_rgb_avx2(&y[i + 4], 
+            load_chroma_avx2(&pb[k4], pixels_per_chroma),
+            load_chroma_avx2(&pr[k4], pixels_per_chroma), denom, 
+            &rgb[3 * (i + 4)]);
+    }
 
-    return component_video;
+    unsigned k = i / pixels_per_chroma;
+    cv_row_to_rgb_scalar(&y[i], &pb[k], &pr[k], length - i, 
+        pixels_per_chroma, denominator, &rgb[3 * i]);
 }
 
-/* create_scaled_rgb
-    Purpose: Create a Pnm_ppm from a 2D array of component video pixels.
+#endif
 
-    Parameters:
-        A2Methods_UArray2 - array of component video. It is a blocked array
-            with each block storing a 2x2 chunk of pixels
-        A2Methods_T methods - methods to create and operate on 2D array
+/* cv_row_to_rgb
+    Purpose: Convert a scanline of component video, stored as a Y plane and
+        Pb and Pr planes with one value for every pixels_per_chroma pixels,
+        to scaled RGB packed three bytes per pixel. Uses AVX2 when the
+        processor has it; the results are the same either way.
 
-    Returns: 
-        Pnm_ppm image - scaled rgb image created from component video pixels
+    Parameters:
+        double *y - array of length luminances
+        float *pb - Pb values, one for every pixels_per_chroma pixels
+        float *pr - Pr values, one for every pixels_per_chroma pixels
+        unsigned length - number of pixels to convert
+        unsigned pixels_per_chroma - 2 for a scanline of a row of blocks,
+            or 1 for a scanline with a Pb and Pr for every pixel
+        int denominator - value to scale RGB values by, at most 255
+        unsigned char *rgb - array of 3 * length bytes, these values will be
+            set
 */
-Pnm_ppm create_scaled_rgb (A2Methods_UArray2 array2, A2Methods_T methods)
+void cv_row_to_rgb (double *y, float *pb, float *pr, unsigned length,
+    unsigned pixels_per_chroma, int denominator, unsigned char *rgb)
 {
-    
-    /* small denominators can cause a large loss of data during compression,
-        but making a denominator too large doesn't have significant effects on
-        precision. That said, it does make the file a lot bigger. We've found
-        255 to be a happy medium */
-    int denominator = 255;
-    unsigned width = methods->width(array2);
-    unsigned height = methods->height(array2);
-
-    struct Small_Closure cl = {
-        .denominator = denominator,
-        .methods = methods,
-        .array2 = array2
-    };
-
-    A2Methods_UArray2 rgb_data = methods->new(width, height,
-        sizeof(struct Pnm_rgb));
-
-    methods->map_default(rgb_data, convert_to_scaled_rgb, &cl);
+    assert(denominator > 0 && denominator < 256);
+    assert(pixels_per_chroma == 1 || pixels_per_chroma == 2);
 
-    Pnm_ppm image = malloc(sizeof(*image));
-    assert(image != NULL);
-
-    *image = (struct Pnm_ppm) {
-        .width = width, .height = height,
-        .denominator = denominator, 
-        .pixels = rgb_data,
-        .methods = methods
-    };
+#ifdef HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2")) {
+        cv_row_to_rgb_avx2(y, pb, pr, length, pixels_per_chroma, 
+            denominator, rgb);
+        return;
+    }
+#endif
 
-    return image;
-}
\ No newline at end of file
+    cv_row_to_rgb_scalar(y, pb, pr, length, pixels_per_chroma, denominator,
+        rgb);
+}
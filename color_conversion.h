@@ -2,7 +2,7 @@
    color_conversion.h
    Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
    Date: 27 October 2021
-   Purpose: Interface for converting Pnm_ppms to compnent video 2D arrays and
+   Purpose: Interface for converting rows of pixels to component video and
        vice-versa 
 */
 #ifndef COLOR_CONVERSION_INCLUDED
@@ -11,39 +11,100 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
-#include <arith40.h>
-#include <a2methods.h>
 #include <pnm.h>
 
 /* represents pixel in component-video space */
 typedef struct CV_Pixel {
     double y, pb, pr;
-    unsigned pb_index, pr_index;
 } CV_Pixel;
 
-/* create_component_video
-    Purpose: Create a 2D array of component video pixels from a Pnm_ppm.
+/* Component video of a row of 2x2 blocks, stored as planes: a luminance for
+    every pixel of the row's two scanlines, and one Pb and one Pr for each
+    block, which is all a codeword keeps of a block's chroma. The chromas
+    are floats because the codec quantizes them as floats; the luminances
+    stay doubles so that codewords are the same as before. n blocks take
+    40n bytes instead of 96n for full-resolution double Y, Pb and Pr. */
+typedef struct CV_Planes {
+    double *top_y;      /* 2 * blocks luminances of the upper scanline */
+    double *bottom_y;   /* 2 * blocks luminances of the lower scanline */
+    float *pb, *pr;     /* blocks chromas each, one per block */
+} CV_Planes;
+
+/* pixel_to_cv
+    Purpose: Scale a Pnm_rgb pixel by its image's denominator and convert it
+        to component video.
+
+    Parameters:
+        Pnm_rgb pixel - pixel to convert
+        unsigned denominator - denominator of the image the pixel belongs to
+
+    Returns: CV_Pixel - converted pixel
+*/
+CV_Pixel pixel_to_cv (Pnm_rgb pixel, unsigned denominator);
+
+/* cv_to_rgb
+    Purpose: Convert component video pixel to scaled rgb pixel.
 
     Parameters:
-        Pnm_ppm image - image to create component video array from
-        A2Methods_T methods - methods to create and operate on 2D array
+        CV_Pixel - component video pixel
+        int denominator - value to scale RGB values by
+    
+    Returns: struct Pnm_rgb - converted pixel
+*/
+struct Pnm_rgb cv_to_rgb (CV_Pixel cv_pix, int denominator);
+
+/* rgb_row_to_cv
+    Purpose: Convert a row of 2x2 blocks of Pnm_rgb pixels, given as its two
+        scanlines, to component video planes. Each block's Pb and Pr are the
+        averages of its four pixels'. Uses AVX2 when the processor has it;
+        the results are the same either way.
 
-    Returns: A2Methods_UArray2 - array of component video. It is a blocked
-        array with each block storing a 2x2 chunk of pixels
+    Parameters:
+        struct Pnm_rgb *top - upper scanline of at least 2 * blocks pixels
+        struct Pnm_rgb *bottom - lower scanline of at least 2 * blocks
+            pixels
+        unsigned blocks - number of blocks to convert
+        unsigned denominator - denominator of the image the pixels belong to
+        CV_Planes *planes - planes with room for blocks blocks, these values
+            will be set
 */
-A2Methods_UArray2 create_component_video (Pnm_ppm image, A2Methods_T methods);
+void rgb_row_to_cv (struct Pnm_rgb *top, struct Pnm_rgb *bottom, 
+    unsigned blocks, unsigned denominator, CV_Planes *planes);
 
-/* create_scaled_rgb
-    Purpose: Create a Pnm_ppm from a 2D array of component video pixels.
+/* packed_row_to_cv
+    Purpose: Convert a row of 2x2 blocks of packed 8-bit RGB pixels, as
+        stored in a raw PPM, to component video planes. Gives the same
+        results as rgb_row_to_cv on the same pixels.
 
     Parameters:
-        A2Methods_UArray2 - array of component video. It is a blocked array
-            with each block storing a 2x2 chunk of pixels
-        A2Methods_T methods - methods to create and operate on 2D array
+        unsigned char *top - upper scanline of at least 6 * blocks bytes
+        unsigned char *bottom - lower scanline of at least 6 * blocks bytes
+        unsigned blocks - number of blocks to convert
+        unsigned denominator - denominator of the image, less than 256
+        CV_Planes *planes - planes with room for blocks blocks, these values
+            will be set
+*/
+void packed_row_to_cv (unsigned char *top, unsigned char *bottom, 
+    unsigned blocks, unsigned denominator, CV_Planes *planes);
+
+/* cv_row_to_rgb
+    Purpose: Convert a scanline of component video, stored as a Y plane and
+        Pb and Pr planes with one value for every pixels_per_chroma pixels,
+        to scaled RGB packed three bytes per pixel. Uses AVX2 when the
+        processor has it; the results are the same either way.
 
-    Returns: 
-        Pnm_ppm image - scaled rgb image created from component video pixels
+    Parameters:
+        double *y - array of length luminances
+        float *pb - Pb values, one for every pixels_per_chroma pixels
+        float *pr - Pr values, one for every pixels_per_chroma pixels
+        unsigned length - number of pixels to convert
+        unsigned pixels_per_chroma - 2 for a scanline of a row of blocks,
+            or 1 for a scanline with a Pb and Pr for every pixel
+        int denominator - value to scale RGB values by, at most 255
+        unsigned char *rgb - array of 3 * length bytes, these values will be
+            set
 */
-Pnm_ppm create_scaled_rgb (A2Methods_UArray2 array2, A2Methods_T methods);
+void cv_row_to_rgb (double *y, float *pb, float *pr, unsigned length,
+    unsigned pixels_per_chroma, int denominator, unsigned char *rgb);
 
 #endif
\ No newline at end of file
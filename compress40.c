@@ -3,101 +3,628 @@
    Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
    Date: 27 October 2021
    Purpose: High-level functions for compressing images into codewords and
-        decompressing codewords into images.
+        decompressing codewords into images, with a Codec40 context or with
+        the default context compress40 and decompress40 share.
 */
 #include "compress40.h"
 
 #include <stdlib.h>
 #include <string.h>
-#include <seq.h>
+#include <errno.h>
 #include <assert.h>
 #include <pnm.h>
-#include <a2methods.h>
 
-#include "a2plain.h"
 #include "color_conversion.h"
 #include "dct.h"
 #include "codewords.h"
 #include "readwrite.h"
+#include "fused.h"
+#include "fixed.h"
+#include "pool.h"
+#include "arena.h"
+#include "options.h"
+#include "context.h"
 
 #define DCT_PIXEL_SIZE 2
 
+/* Denominator of decompressed images. A larger denominator doesn't do much
+    for precision but makes the file a lot bigger, so 255 is a happy medium */
+#define RGB_DENOMINATOR 255
+
+/* Rows of blocks are split into strips of this many rows, and each strip is
+    one job for the thread pool. We read enough rows for a few strips per
+    thread at a time so that threads that finish early can pick up more. */
+#define STRIP_HEIGHT 4
+#define STRIPS_PER_THREAD 2
+
 /* How values are stored in a codeword. This scheme is used by both compress
     and decompress functions. We want to keep this modular, so we just 
     initialize the packing scheme with constants on one line */
 PackingScheme_T packingscheme = { 9, 23, 5, 18, 5, 13, 5, 8, 4, 4, 4, 0 };
 
-/* compress40
+/* Single-threaded, double-precision and writing format 2 without
+    prediction unless 40image is told otherwise */
+Options_T compress40_options = { 1, 0, PLAIN_FORMAT, NO_PREDICTOR };
+
+/* Context of compress40, decompress40 and the region functions, which
+    take their options from compress40_options on every call. Its workspace
+    is freed by compress40_release. */
+static struct Codec40 default_codec;
+
+/* workspace_pool
+    Purpose: get a pool of a given number of threads, reusing the one kept
+        in the workspace when it has the same number.
+
+    Parameters:
+        struct Workspace *workspace - workspace to keep the pool in
+        unsigned threads - number of threads
+
+    Returns: Pool_T - pool owned by the workspace, not to be freed
+*/
+Pool_T workspace_pool (struct Workspace *workspace, unsigned threads)
+{
+    if (workspace->pool != NULL && 
+        Pool_threads(workspace->pool) != threads) {
+        Pool_free(&workspace->pool);
+    }
+
+    if (workspace->pool == NULL) {
+        workspace->pool = Pool_new(threads);
+    }
+
+    return workspace->pool;
+}
+
+/* workspace_arena
+    Purpose: get the workspace's arena, emptied of the last image's memory.
+
+    Parameters: struct Workspace *workspace - workspace to keep the arena in
+
+    Returns: Arena_T - arena owned by the workspace, not to be freed
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+Arena_T workspace_arena (struct Workspace *workspace)
+{
+    if (workspace->arena == NULL) {
+        workspace->arena = Arena_new(1);
+    } else {
+        Arena_reset(workspace->arena);
+    }
+
+    return workspace->arena;
+}
+
+/* free_workspace
+    Purpose: Free a workspace's thread pool and arena, leaving it empty and
+        ready to use again.
+
+    Parameters: struct Workspace *workspace - workspace to empty
+*/
+void free_workspace (struct Workspace *workspace)
+{
+    if (workspace->pool != NULL) {
+        Pool_free(&workspace->pool);
+    }
+
+    if (workspace->arena != NULL) {
+        Arena_free(&workspace->arena);
+    }
+}
+
+/* compress40_release
+    Purpose: Free the thread pool and memory compress40 and decompress40
+        keep between images.
+*/
+void compress40_release (void)
+{
+    free_workspace(&default_codec.workspace);
+}
+
+/* Used by compress_strip and decompress_strip. Block row i covers scanlines
+    2i and 2i + 1 of the batch, and its codewords start at
+    codewords[i * block_width]. Compression reads scanlines of Pnm_rgb
+    pixels, or scanlines of packed 8-bit RGB straight from a memory-mapped
+    file when packed is not NULL. Decompression writes scanlines of packed
+    8-bit RGB. fixed_point picks the kernels in fixed.c. */
+struct Strip_Closure {
+    struct Pnm_rgb *scanlines;
+    unsigned char *packed;
+    uint32_t *codewords;
+    unsigned nrows;
+    unsigned image_width, block_width;
+    unsigned denominator;
+    int fixed_point;
+};
+
+/* Used by encode_tiles and decode_tiles. The tiles of a batch start at
+    tile first, and tile first + i starts at
+    codewords[i * tile_rows * block_width]. decode_tiles puts what
+    read_codeword_tile returns for tile first + i in errors[i], so that
+    jobs on different threads never write the same memory. */
+struct Tile_Closure {
+    Codeword_Writer writer;
+    Codeword_Reader reader;
+    uint32_t *codewords;
+    int *errors;
+    unsigned first;
+    unsigned tile_rows, block_width;
+};
+
+/* encode_tiles
+    Purpose: Entropy code one tile of a batch of codewords. Called by
+        Pool_run in compress_image.
+
+    Parameters: See Pool_applyfun for more info.
+*/
+static void encode_tiles (unsigned job, void *cl)
+{
+    struct Tile_Closure *tcl = (struct Tile_Closure *) cl;
+
+    write_codeword_tile(tcl->writer, tcl->first + job, &tcl->codewords[
+        (size_t) job * tcl->tile_rows * tcl->block_width]);
+}
+
+/* decode_tiles
+    Purpose: Decode one tile of a batch of codewords. Called by Pool_run in
+        decompress_image.
+
+    Parameters: See Pool_applyfun for more info.
+*/
+static void decode_tiles (unsigned job, void *cl)
+{
+    struct Tile_Closure *tcl = (struct Tile_Closure *) cl;
+
+    tcl->errors[job] = read_codeword_tile(tcl->reader, tcl->first + job, 
+        &tcl->codewords[(size_t) job * tcl->tile_rows * tcl->block_width]);
+}
+
+/* read_ppm_rows
+    Purpose: Read rows of a PPM into consecutive scanlines.
+
+    Parameters:
+        Ppm_Reader reader - reader to read from
+        struct Pnm_rgb *scanlines - array of nrows * reader->width pixels,
+            these values will be set
+        unsigned nrows - number of rows to read
+
+    Returns: int - 0, or the error from read_ppm_row
+*/
+static int read_ppm_rows (Ppm_Reader reader, struct Pnm_rgb *scanlines,
+    unsigned nrows)
+{
+    unsigned i;
+    for (i = 0; i < nrows; i++) {
+        int error = read_ppm_row(reader, 
+            &scanlines[(size_t) i * reader->width]);
+        if (error != 0) {
+            return error;
+        }
+    }
+
+    return 0;
+}
+
+/* tile_batch
+    Purpose: round a batch of block rows up to a whole number of tiles, so
+        that every tile of a format 3 image is in a single batch.
+
+    Parameters:
+        unsigned batch - rows of blocks wanted in a batch
+        unsigned tile_rows - rows of blocks in a tile, or 0 for format 2
+
+    Returns: unsigned - rows of blocks in a batch
+*/
+static unsigned tile_batch (unsigned batch, unsigned tile_rows)
+{
+    if (tile_rows == 0) {
+        return batch;
+    }
+
+    return (batch + tile_rows - 1) / tile_rows * tile_rows;
+}
+
+/* compress_strip
+    Purpose: Compress one strip of block rows into its slots in the codeword
+        array. Called by Pool_run in compress_image.
+
+    Parameters: See Pool_applyfun for more info.
+*/
+static void compress_strip (unsigned job, void *cl)
+{
+    struct Strip_Closure *scl = (struct Strip_Closure *) cl;
+
+    unsigned first = job * STRIP_HEIGHT;
+    unsigned last = first + STRIP_HEIGHT;
+    if (last > scl->nrows) {
+        last = scl->nrows;
+    }
+
+    unsigned row;
+
+    if (scl->packed != NULL) {
+        size_t stride = (size_t) 3 * scl->image_width;
+
+        for (row = first; row < last; row++) {
+            unsigned char *top = &scl->packed[(2 * row) * stride];
+            unsigned char *bottom = &scl->packed[(2 * row + 1) * stride];
+
+            uint32_t *codewords = &scl->codewords[
+                (size_t) row * scl->block_width];
+
+            if (scl->fixed_point) {
+                compress_packed_rows_fixed(top, bottom, scl->block_width,
+                    scl->denominator, packingscheme, codewords);
+            } else {
+                compress_packed_rows(top, bottom, scl->block_width,
+                    scl->denominator, packingscheme, codewords);
+            }
+        }
+        return;
+    }
+
+    for (row = first; row < last; row++) {
+        struct Pnm_rgb *top = &scl->scanlines[
+            (size_t) (2 * row) * scl->image_width];
+        struct Pnm_rgb *bottom = &scl->scanlines[
+            (size_t) (2 * row + 1) * scl->image_width];
+
+        uint32_t *codewords = &scl->codewords[
+            (size_t) row * scl->block_width];
+
+        if (scl->fixed_point) {
+            compress_rows_fixed(top, bottom, scl->block_width,
+                scl->denominator, packingscheme, codewords);
+        } else {
+            compress_rows(top, bottom, scl->block_width, scl->denominator,
+                packingscheme, codewords);
+        }
+    }
+}
+
+/* decompress_strip
+    Purpose: Decompress one strip of block rows from the codeword array into
+        its scanlines. Called by Pool_run in decompress_image.
+
+    Parameters: See Pool_applyfun for more info.
+*/
+static void decompress_strip (unsigned job, void *cl)
+{
+    struct Strip_Closure *scl = (struct Strip_Closure *) cl;
+
+    unsigned first = job * STRIP_HEIGHT;
+    unsigned last = first + STRIP_HEIGHT;
+    if (last > scl->nrows) {
+        last = scl->nrows;
+    }
+
+    size_t stride = (size_t) 3 * scl->image_width;
+
+    unsigned row;
+    for (row = first; row < last; row++) {
+        unsigned char *top = &scl->packed[(2 * row) * stride];
+        unsigned char *bottom = &scl->packed[(2 * row + 1) * stride];
+
+        uint32_t *codewords = &scl->codewords[
+            (size_t) row * scl->block_width];
+
+        if (scl->fixed_point) {
+            decompress_rows_fixed(codewords, scl->block_width,
+                packingscheme, scl->denominator, top, bottom);
+        } else {
+            decompress_rows(codewords, scl->block_width, packingscheme,
+                scl->denominator, top, bottom);
+        }
+    }
+}
+
+/* finish_output
+    Purpose: Flush a stream that a result was written to.
+
+    Parameters: FILE *output - stream to flush
+
+    Returns: int - 0, or EIO or the errno of the failure if any of the
+        result could not be written
+*/
+int finish_output (FILE *output)
+{
+    if (fflush(output) != 0) {
+        return errno != 0 ? errno : EIO;
+    }
+
+    return ferror(output) ? EIO : 0;
+}
+
+/* compress40_codec
+    Purpose: Get the context compress40, decompress40 and the region
+        functions share, with its options set from compress40_options.
+
+    Returns: Codec40 - shared context, not to be freed
+*/
+Codec40 compress40_codec (void)
+{
+    default_codec.options = compress40_options;
+    return &default_codec;
+}
+
+/* compress_image
     
     Purpose: Given an image file, compress it into codewords and write the
-        codewords to stdout
+        codewords to output, one batch of block rows at a time. Strips of
+        each batch are compressed in parallel on the codec's threads. Raw
+        PPM files with 8-bit samples are compressed straight from a memory
+        mapping of the file, without copying any pixels. In format 3, the
+        tiles of each batch are then entropy coded in parallel, and written
+        out after the batch if the output can seek.
 
-    Parameters: FILE *input - stream to read into image
+    Parameters:
+        Codec40 codec - context to use
+        FILE *input - stream to read into image
+        FILE *output - stream to write the compressed image to
 
-    Errors: Throws an error if input is NULL
+    Returns: int - 0, EINVAL if any argument is NULL or the input is not a
+        PPM, EBADMSG if the input is malformed or ends early, the error
+        from close_codeword_writer if the tile index cannot be filled in, or
+        the error from finish_output if the output cannot be written. What
+        was written of a malformed image is left in output.
 */
-void compress40 (FILE *input)
+int compress_image (Codec40 codec, FILE *input, FILE *output)
 {
-        assert(input != NULL);
+        if (codec == NULL || input == NULL || output == NULL) {
+                return EINVAL;
+        }
+
+        Options_T *options = &codec->options;
+        unsigned threads = options->threads;
+        assert(threads > 0);
+
+        /* Only a batch of block rows is held in memory at a time, so memory
+            use does not depend on the image's height. Every strip of the
+            batch writes to its own slots in the codeword array, so the
+            output is the same no matter how many threads there are. */
+        Arena_T arena = workspace_arena(&codec->workspace);
+        Ppm_Reader reader = open_ppm_reader(input, arena);
+        if (reader == NULL) {
+                return errno;
+        }
 
-    A2Methods_T plain_methods = uarray2_methods_plain;
+        unsigned width = reader->width / DCT_PIXEL_SIZE;
+        unsigned height = reader->height / DCT_PIXEL_SIZE;
 
-        Pnm_ppm image = read_image(input, plain_methods);
+        Codeword_Writer writer = open_codeword_writer(output, width, height,
+                options->format, options->predictor, packingscheme, arena);
 
-        A2Methods_UArray2 component_video = create_component_video(image, 
-                plain_methods);
+        unsigned batch = tile_batch(STRIP_HEIGHT * STRIPS_PER_THREAD * 
+                threads, writer->tile_rows);
 
-        A2Methods_UArray2 dct = discrete_cosine_transform(component_video, 
-                plain_methods);
+        int mapped = reader->raster != NULL;
+        size_t stride = (size_t) 3 * reader->width;
 
-        Seq_T codewords = generate_codewords(dct, plain_methods, 
-            packingscheme);
+        struct Pnm_rgb *scanlines = NULL;
+        if (!mapped) {
+                scanlines = Arena_alloc(arena, ((size_t) DCT_PIXEL_SIZE * 
+                        batch * reader->width + 1) * sizeof(*scanlines));
+        }
 
-        write_codewords(codewords, plain_methods->width(dct),
-                plain_methods->height(dct));
+        uint32_t *codewords = Arena_alloc(arena, ((size_t) batch * width + 
+                1) * sizeof(*codewords));
 
-        plain_methods->free(&component_video);
-        plain_methods->free(&dct);
+        Pool_T pool = workspace_pool(&codec->workspace, threads);
 
-        free_codeword_seq(&codewords);
-        Pnm_ppmfree(&image);
+        struct Strip_Closure cl = {
+                .scanlines = scanlines,
+                .packed = NULL,
+                .codewords = codewords,
+                .image_width = reader->width,
+                .block_width = width,
+                .denominator = reader->denominator,
+                .fixed_point = options->fixed_point
+        };
+
+        struct Tile_Closure tcl = {
+                .writer = writer,
+                .codewords = codewords,
+                .tile_rows = writer->tile_rows,
+                .block_width = width
+        };
+
+        int error = 0;
+        unsigned row;
+        for (row = 0; row < height; row += cl.nrows) {
+                cl.nrows = height - row < batch ? height - row : batch;
+
+                if (mapped) {
+                        cl.packed = &reader->raster[
+                                (size_t) DCT_PIXEL_SIZE * row * stride];
+                } else {
+                        error = read_ppm_rows(reader, scanlines, 
+                                DCT_PIXEL_SIZE * cl.nrows);
+                        if (error != 0) {
+                                break;
+                        }
+                }
+
+                Pool_run(pool, (cl.nrows + STRIP_HEIGHT - 1) / STRIP_HEIGHT,
+                        compress_strip, &cl);
+
+                if (writer->format == TILED_FORMAT) {
+                        tcl.first = row / writer->tile_rows;
+                        Pool_run(pool, (cl.nrows + writer->tile_rows - 1) / 
+                                writer->tile_rows, encode_tiles, &tcl);
+                        flush_codeword_tiles(writer);
+                } else {
+                        write_codeword_rows(writer, codewords, cl.nrows);
+                }
+        }
+
+        if (error != 0) {
+                free_codeword_writer(&writer);
+                free_ppm_reader(&reader);
+                return error;
+        }
+
+        error = close_codeword_writer(&writer);
+        free_ppm_reader(&reader);
+
+        int flushed = finish_output(output);
+        return error != 0 ? error : flushed;
 }
 
-/* decompress40
+/* compress40
     
-    Purpose: Given a codeword file, decompress it into an image and write the
-        image to stdout
+    Purpose: Given an image file, compress it into codewords and write the
+        codewords to stdout, with the options in compress40_options. See
+        compress_image for more info.
 
     Parameters: FILE *input - stream to read into image
 
-    Errors: Throws an error if input is NULL
+    Errors: Throws an error if input is NULL, is not a PPM or is malformed,
+        or if the output cannot be written
 */
-void decompress40(FILE *input)
+void compress40 (FILE *input)
+{
+        int error = compress_image(compress40_codec(), input, stdout);
+        assert(error == 0);
+}
+
+/* decompress_image
+    
+    Purpose: Given a codeword file, decompress it into an image and write the
+        image to output, one batch of block rows at a time. Strips of each
+        batch are decompressed in parallel on the codec's threads. Either
+        format can be read; format 3 tiles of each batch are decoded in
+        parallel first.
+
+    Parameters:
+        Codec40 codec - context to use
+        FILE *input - stream to read into image
+        FILE *output - stream to write the PPM to
+
+    Returns: int - 0, EINVAL if any argument is NULL or the input is not a
+        compressed image, EBADMSG or the error from the reader if the input
+        is malformed or ends early, or the error from finish_output if the
+        output cannot be written. What was decompressed of a malformed
+        image is left in output.
+*/
+int decompress_image (Codec40 codec, FILE *input, FILE *output)
 {
-        assert(input != NULL);
+        if (codec == NULL || input == NULL || output == NULL) {
+                return EINVAL;
+        }
+
+        unsigned threads = codec->options.threads;
+        assert(threads > 0);
+
+        Arena_T arena = workspace_arena(&codec->workspace);
+        Codeword_Reader reader = open_codeword_reader(input, packingscheme,
+                arena);
+        if (reader == NULL) {
+                return errno;
+        }
+
+        unsigned block_width = reader->width;
+        unsigned block_height = reader->height;
+        unsigned batch = tile_batch(STRIP_HEIGHT * STRIPS_PER_THREAD * 
+                threads, reader->tile_rows);
+
+        /* Each batch of codeword rows is written out as soon as it is
+            decoded, so memory use does not depend on the image's height and
+            output starts right away. Every strip decodes into its own
+            scanlines, so the output is the same no matter how many threads
+            there are. */
+        Ppm_Writer writer = open_ppm_writer(output,
+                block_width * DCT_PIXEL_SIZE, block_height * DCT_PIXEL_SIZE,
+                RGB_DENOMINATOR, arena);
+
+        uint32_t *codewords = Arena_alloc(arena, ((size_t) batch * 
+                block_width + 1) * sizeof(*codewords));
 
-    A2Methods_T plain_methods = uarray2_methods_plain;
+        /* a batch of format 3 is a whole number of tiles */
+        int *errors = NULL;
+        if (reader->format == TILED_FORMAT) {
+                errors = Arena_alloc(arena, (batch / reader->tile_rows + 1)
+                        * sizeof(*errors));
+        }
 
-        unsigned width;
-        unsigned height;
+        Pool_T pool = workspace_pool(&codec->workspace, threads);
 
-        Seq_T codewords = read_codewords (input, &width, &height);
-        
-        A2Methods_UArray2 dct2 = generate_dct(codewords, plain_methods, 
-                width / DCT_PIXEL_SIZE,
-                height / DCT_PIXEL_SIZE,
-                packingscheme
-        );
+        struct Strip_Closure cl = {
+                .codewords = codewords,
+                .image_width = writer->width,
+                .block_width = block_width,
+                .denominator = RGB_DENOMINATOR,
+                .fixed_point = codec->options.fixed_point
+        };
 
-        A2Methods_UArray2 cv2 = dct_to_pixel_space(dct2, plain_methods);
+        struct Tile_Closure tcl = {
+                .reader = reader,
+                .codewords = codewords,
+                .errors = errors,
+                .tile_rows = reader->tile_rows,
+                .block_width = block_width
+        };
 
-        Pnm_ppm scaled_rgb = create_scaled_rgb(cv2, plain_methods);
+        int error = 0;
+        unsigned row;
+        for (row = 0; row < block_height; row += cl.nrows) {
+                cl.nrows = block_height - row < batch ? 
+                        block_height - row : batch;
 
-        write_image(scaled_rgb);
+                if (reader->format == TILED_FORMAT) {
+                        unsigned ntiles = (cl.nrows + reader->tile_rows - 1)
+                                / reader->tile_rows;
 
-        plain_methods->free(&dct2);
-        plain_methods->free(&cv2);
+                        tcl.first = row / reader->tile_rows;
+                        error = load_codeword_tiles(reader, tcl.first, 
+                                ntiles);
+                        if (error == 0) {
+                                Pool_run(pool, ntiles, decode_tiles, &tcl);
+                        }
 
-        Seq_free(&codewords);
-        Pnm_ppmfree(&scaled_rgb);
+                        unsigned tile;
+                        for (tile = 0; tile < ntiles && error == 0; tile++) {
+                                error = errors[tile];
+                        }
+                } else {
+                        error = read_codeword_rows(reader, codewords, 
+                                cl.nrows);
+                }
+
+                if (error != 0) {
+                        break;
+                }
+
+                /* scanlines are decoded straight into the writer's buffer,
+                    which is written out in large chunks as it fills */
+                cl.packed = next_ppm_rows(writer, DCT_PIXEL_SIZE * cl.nrows);
+
+                Pool_run(pool, (cl.nrows + STRIP_HEIGHT - 1) / STRIP_HEIGHT,
+                        decompress_strip, &cl);
+        }
+
+        free_ppm_writer(&writer);
+        free_codeword_reader(&reader);
+
+        if (error != 0) {
+                return error;
+        }
+
+        return finish_output(output);
+}
+
+/* decompress40
+    
+    Purpose: Given a codeword file, decompress it into an image and write the
+        image to stdout, with the options in compress40_options. See
+        decompress_image for more info.
+
+    Parameters: FILE *input - stream to read into image
+
+    Errors: Throws an error if input is NULL, is not a compressed image or
+        is malformed, or if the output cannot be written
+*/
+void decompress40(FILE *input)
+{
+        int error = decompress_image(compress40_codec(), input, stdout);
+        assert(error == 0);
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+/*
+   context.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: What a Codec40 context holds, shared by compress40.c, region.c
+       and codec40.c. Not part of the library's interface.
+*/
+#ifndef CONTEXT_INCLUDED
+#define CONTEXT_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "pool.h"
+#include "arena.h"
+#include "options.h"
+#include "codec40.h"
+
+/* Thread pool and arena kept from one image to the next, so that when one
+    process (de)compresses many images, as in 40image --batch or 40imaged,
+    it does not start threads or allocate and fault in memory for each one.
+    Everything an image needs, from batch buffers to readers, writers and
+    encoded tiles, comes from the arena, which is reset for the next image
+    instead of freed. Its slabs are backed by huge pages where possible. */
+struct Workspace {
+        Pool_T pool;
+        Arena_T arena;
+};
+
+/* Closure of a stream made from a Codec40_reader or Codec40_writer. failed
+    is set once write does not take all of the output, after which the rest
+    is dropped instead of passed on. */
+struct Callback {
+        Codec40_reader *read;
+        Codec40_writer *write;
+        void *cl;
+        int failed;
+};
+
+/* Streams and output buffer of the buffer or callback conversion in
+    progress. They are kept in the context rather than on the stack so that
+    a conversion cut short by a failed assertion does not leak them: they
+    are closed and freed by the next conversion or by Codec40_free. */
+struct Pending {
+        FILE *input, *output;
+        char *buffer;
+        size_t length;
+        struct Callback reader, writer;
+};
+
+/* A codec context: options and the workspace used with them */
+struct Codec40 {
+        Options_T options;
+        struct Workspace workspace;
+        struct Pending pending;
+};
+
+/* workspace_pool
+        Purpose: get a pool of a given number of threads, reusing the one
+                kept in the workspace when it has the same number. Defined
+                in compress40.c.
+
+        Parameters:
+                struct Workspace *workspace - workspace to keep the pool in
+                unsigned threads - number of threads
+
+        Returns: Pool_T - pool owned by the workspace, not to be freed
+*/
+Pool_T workspace_pool (struct Workspace *workspace, unsigned threads);
+
+/* workspace_arena
+        Purpose: get the workspace's arena, emptied of the last image's
+                memory. Defined in compress40.c.
+
+        Parameters: struct Workspace *workspace - workspace to keep the
+                arena in
+
+        Returns: Arena_T - arena owned by the workspace, not to be freed
+
+        Errors: Throws an error if it cannot allocate memory.
+*/
+Arena_T workspace_arena (struct Workspace *workspace);
+
+/* free_workspace
+        Purpose: Free a workspace's thread pool and arena, leaving it empty
+                and ready to use again. Defined in compress40.c.
+
+        Parameters: struct Workspace *workspace - workspace to empty
+*/
+void free_workspace (struct Workspace *workspace);
+
+/* finish_output
+        Purpose: Flush a stream that a result was written to. Defined in
+                compress40.c.
+
+        Parameters: FILE *output - stream to flush
+
+        Returns: int - 0, or EIO or the errno of the failure if any of the
+                result could not be written
+*/
+int finish_output (FILE *output);
+
+/* compress40_codec
+        Purpose: Get the context compress40, decompress40 and the region
+                functions share, with its options set from
+                compress40_options. Defined in compress40.c.
+
+        Returns: Codec40 - shared context, not to be freed
+*/
+Codec40 compress40_codec (void);
+
+/* compress_image
+        Purpose: Compress a PPM from one stream to another with a context's
+                options and workspace. Defined in compress40.c; see
+                Codec40_compress_file.
+
+        Parameters:
+                Codec40 codec - context to use
+                FILE *input - stream to read a PPM from
+                FILE *output - stream to write the compressed image to
+
+        Returns: int - 0, EINVAL if any argument is NULL or the input is
+                not a PPM, EBADMSG if the input is malformed, or the error
+                from finish_output
+*/
+int compress_image (Codec40 codec, FILE *input, FILE *output);
+
+/* decompress_image
+        Purpose: Decompress a compressed image from one stream to another
+                with a context's options and workspace. Defined in
+                compress40.c; see Codec40_decompress_file.
+
+        Parameters:
+                Codec40 codec - context to use
+                FILE *input - stream to read a compressed image from
+                FILE *output - stream to write the PPM to
+
+        Returns: int - 0, EINVAL if any argument is NULL or the input is
+                not a compressed image, EBADMSG if the input is malformed,
+                or the error from finish_output
+*/
+int decompress_image (Codec40 codec, FILE *input, FILE *output);
+
+/* decompress_region
+        Purpose: Decompress a rectangle of a compressed image from one
+                stream to another with a context's options and workspace.
+                Defined in region.c; see Codec40_decompress_region.
+
+        Parameters:
+                Codec40 codec - context to use
+                FILE *input - stream to read a compressed image from
+                FILE *output - stream to write the PPM to
+                unsigned x, y - the rectangle's top left corner, in pixels
+                unsigned width, height - the rectangle's size, in pixels
+
+        Returns: int - 0, EINVAL if any argument is NULL, the input is not
+                a compressed image or the rectangle is empty or starts
+                outside the image, EBADMSG if the input is malformed, or the
+                error from finish_output
+*/
+int decompress_region (Codec40 codec, FILE *input, FILE *output,
+        unsigned x, unsigned y, unsigned width, unsigned height);
+
+/* decompress_thumbnail
+        Purpose: Decompress a compressed image at half its width and height
+                from one stream to another with a context's options and
+                workspace. Defined in region.c; see
+                Codec40_decompress_thumbnail.
+
+        Parameters:
+                Codec40 codec - context to use
+                FILE *input - stream to read a compressed image from
+                FILE *output - stream to write the PPM to
+
+        Returns: int - 0, EINVAL if any argument is NULL or the input is
+                not a compressed image, EBADMSG if the input is malformed,
+                or the error from finish_output
+*/
+int decompress_thumbnail (Codec40 codec, FILE *input, FILE *output);
+
+#endif
@@ -2,13 +2,12 @@
    dct.c
    Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
    Date: 27 October 2021
-   Purpose: Interface for applying discrete cosine transform on component video
-    2D arrays, and for converting DCT Block arrays back to component video.
+   Purpose: Interface for applying discrete cosine transform to 2x2 blocks of
+    component video pixels, and for converting DCT Blocks back to pixels.
 */
 #ifndef DCT_INCLUDED
 #define DCT_INCLUDED
 
-#include <a2methods.h>
 #include "color_conversion.h"
 
 /* Represents the result of apply discrete cosine transform on a 2x2 block of
@@ -18,33 +17,29 @@ typedef struct DCT_Block {
     unsigned pb_index, pr_index;
 } DCT_Block;
 
-/* discrete_cosine_transform
-    Purpose: Given a 2D array of component video pixels, apply DCT to each 2x2
-        pixel block and return a 2D array of these DCT_Blocks.
-    
+/* calcuate_ABCD 
+    Purpose: Given the component video of a row of 2x2 blocks, calculate
+        a,b,c,d of one block and store these values, along with its
+        quantized chromas, in a DCT_Block.
+
     Parameters:
-        A2Methods_UArray2 component_video - 2D array of CV_Pixels
-        A2Methods_T methods - methods to operate on component_video and make 
-            output array.
+        CV_Planes *planes - component video of the row
+        unsigned col - index of the block in the row
 
-    Returns: A2Methods_UArray2 - 2D array of DCT_Blocks.
+    Returns: DCT_Block - the block's values
 */
-A2Methods_UArray2 discrete_cosine_transform (
-        A2Methods_UArray2 component_video,
-        A2Methods_T methods);
-
-/* dct_to_pixel_space
-    Purpose: Given a 2D array of DCT_Blocks, get four component video pixels
-        from each block return a 2D array of these pixels.
-    
-    Parameters:
-        A2Methods_UArray2 dct - 2D array of DCT_Blocks
-        A2Methods_T methods - methods to operate on dct and make 
-            output array.
+DCT_Block calculate_ABCD (CV_Planes *planes, unsigned col);
 
-    Returns: A2Methods_UArray2 - 2D array of component video pixels.
+/* calcuate_Ys
+    Purpose: Given a DCT_Block, calculate the luminances of its four pixels
+        and store them in the planes of its row, along with its chromas.
+
+    Parameters:
+        DCT_Block block - block to convert
+        CV_Planes *planes - component video of the row, these values will be
+            set for the block
+        unsigned col - index of the block in the row
 */
-A2Methods_UArray2 dct_to_pixel_space (A2Methods_UArray2 dct, 
-        A2Methods_T methods);
+void calculate_Ys (DCT_Block block, CV_Planes *planes, unsigned col);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,558 @@
+/*
+   entropy.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Functions for entropy coding tiles of codewords with a byte-wise
+       range asymmetric numeral system (rANS) coder.
+
+       A tile is stored as:
+           - a frequency table for each of the six fields (a, b, c, d, Pb,
+             Pr): the number of symbols that occur, then for each one the
+             gap since the previous symbol and its frequency minus one, all
+             as variable-length integers
+           - the coder's final 32-bit state, least significant byte first
+           - the bytes the coder wrote
+       Every field's value is coded as a symbol of its own table, in the
+       order a, b, c, d, Pb, Pr for each codeword in turn.
+*/
+#include "entropy.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+
+/* Fields of a codeword, in the order they are coded */
+#define NUM_FIELDS 6
+
+/* Widest field we can code; its alphabet must be smaller than PROB_SCALE */
+#define MAX_FIELD_WIDTH 12
+
+/* Frequencies of each table add up to PROB_SCALE */
+#define PROB_BITS 14
+#define PROB_SCALE (1u << PROB_BITS)
+
+/* The coder's state stays in [RANS_LOW, RANS_LOW << 8) between symbols */
+#define RANS_LOW (1u << 23)
+
+/* Largest a variable-length integer up to 32 bits can be */
+#define MAX_VARINT_BYTES 5
+
+/* Frequency table of one field. cumulative[s] is the sum of the
+    frequencies of the symbols before s. */
+struct Model {
+    unsigned width, lsb;
+    unsigned symbols;           /* 1 << width */
+    uint32_t frequency[1 << MAX_FIELD_WIDTH];
+    uint32_t cumulative[1 << MAX_FIELD_WIDTH];
+};
+
+/* Working memory of the coder: a model of every field, the counts of one
+    field's symbols while encoding, the symbol of every slot of every field
+    while decoding, and room to encode a tile in before it is copied out at
+    its real size */
+struct Coder_Memory {
+    struct Model models[NUM_FIELDS];
+    uint32_t counts[1 << MAX_FIELD_WIDTH];
+    uint16_t slots[NUM_FIELDS * PROB_SCALE];
+    unsigned char *scratch;
+    size_t scratch_size;
+};
+
+/* Each thread's Coder_Memory, made by its first tile */
+static pthread_once_t memory_once = PTHREAD_ONCE_INIT;
+static pthread_key_t memory_key;
+
+/* free_memory
+    Purpose: free a thread's Coder_Memory. Called when its thread ends.
+
+    Parameters: void *memory - the thread's Coder_Memory
+*/
+static void free_memory (void *memory)
+{
+    free(((struct Coder_Memory *) memory)->scratch);
+    free(memory);
+}
+
+/* make_memory_key
+    Purpose: make the key of each thread's Coder_Memory, which is freed
+        when its thread ends. Called once, by pthread_once.
+*/
+static void make_memory_key (void)
+{
+    int made = pthread_key_create(&memory_key, free_memory) == 0;
+    assert(made);
+}
+
+/* coder_memory
+    Purpose: get the calling thread's working memory for coding a tile.
+        It takes about 400 KB, which malloc would map and unmap again for
+        every tile, so each thread keeps its own from one tile to the next.
+
+    Returns: struct Coder_Memory * - memory of the calling thread
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+static struct Coder_Memory *coder_memory (void)
+{
+    pthread_once(&memory_once, make_memory_key);
+
+    struct Coder_Memory *memory = pthread_getspecific(memory_key);
+    if (memory == NULL) {
+        memory = malloc(sizeof(*memory));
+        assert(memory != NULL);
+        memory->scratch = NULL;
+        memory->scratch_size = 0;
+
+        int kept = pthread_setspecific(memory_key, memory) == 0;
+        assert(kept);
+    }
+
+    return memory;
+}
+
+/* get_fields
+    Purpose: set the width and position of every field of a packing scheme,
+        in the order they are coded.
+
+    Parameters:
+        PackingScheme_T pc - packing scheme
+        struct Model *models - array of NUM_FIELDS models, these widths and
+            positions will be set
+*/
+static void get_fields (PackingScheme_T pc, struct Model *models)
+{
+    unsigned widths[NUM_FIELDS] = {
+        pc.a_width, pc.b_width, pc.c_width, pc.d_width, pc.pb_width, 
+        pc.pr_width
+    };
+    unsigned lsbs[NUM_FIELDS] = {
+        pc.a_lsb, pc.b_lsb, pc.c_lsb, pc.d_lsb, pc.pb_lsb, pc.pr_lsb
+    };
+
+    int f;
+    for (f = 0; f < NUM_FIELDS; f++) {
+        assert(widths[f] > 0 && widths[f] <= MAX_FIELD_WIDTH);
+        models[f].width = widths[f];
+        models[f].lsb = lsbs[f];
+        models[f].symbols = 1u << widths[f];
+    }
+}
+
+/* field_of
+    Purpose: get the symbol a field of a codeword is coded as
+
+    Parameters:
+        uint32_t codeword - codeword to look in
+        struct Model *model - model of the field
+
+    Returns: uint32_t - the field's bits, as an unsigned number
+*/
+static inline uint32_t field_of (uint32_t codeword, struct Model *model)
+{
+    return (codeword >> model->lsb) & (model->symbols - 1);
+}
+
+/* normalize_model
+    Purpose: scale counts of each symbol into frequencies that add up to
+        PROB_SCALE, keeping every symbol that occurs at a frequency of at
+        least 1, and fill in the cumulative frequencies.
+
+    Parameters:
+        struct Model *model - model to fill in
+        uint32_t *counts - how many times each symbol occurs
+        size_t total - sum of counts, greater than zero
+*/
+static void normalize_model (struct Model *model, uint32_t *counts,
+    size_t total)
+{
+    uint32_t assigned = 0;
+    unsigned s, best = 0;
+
+    for (s = 0; s < model->symbols; s++) {
+        uint32_t frequency = 0;
+
+        if (counts[s] > 0) {
+            frequency = (uint64_t) counts[s] * PROB_SCALE / total;
+            if (frequency == 0) {
+                frequency = 1;
+            }
+        }
+
+        model->frequency[s] = frequency;
+        assigned += frequency;
+
+        if (counts[s] > counts[best]) {
+            best = s;
+        }
+    }
+
+    /* Rounding down leaves some of the scale over, which goes to the most
+        common symbol. Rounding rare symbols up to 1 can go over instead,
+        which is taken back from whichever symbols have the most. */
+    if (assigned < PROB_SCALE) {
+        model->frequency[best] += PROB_SCALE - assigned;
+    }
+
+    while (assigned > PROB_SCALE) {
+        unsigned largest = 0;
+        for (s = 1; s < model->symbols; s++) {
+            if (model->frequency[s] > model->frequency[largest]) {
+                largest = s;
+            }
+        }
+
+        assert(model->frequency[largest] > 1);
+        model->frequency[largest]--;
+        assigned--;
+    }
+
+    uint32_t sum = 0;
+    for (s = 0; s < model->symbols; s++) {
+        model->cumulative[s] = sum;
+        sum += model->frequency[s];
+    }
+}
+
+/* coder_scratch
+    Purpose: get room to encode a tile in from a thread's working memory,
+        growing it if the tile could need more than it has. Only the bytes
+        a tile really takes are copied out, so its worst case, about 12
+        bytes per codeword, is only ever held once per thread.
+
+    Parameters:
+        struct Coder_Memory *memory - the calling thread's memory
+        size_t size - bytes needed
+
+    Returns: unsigned char * - at least size bytes, kept by memory
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+static unsigned char *coder_scratch (struct Coder_Memory *memory, 
+    size_t size)
+{
+    if (memory->scratch_size < size) {
+        free(memory->scratch);
+        memory->scratch = malloc(size);
+        assert(memory->scratch != NULL);
+        memory->scratch_size = size;
+    }
+
+    return memory->scratch;
+}
+
+/* put_varint
+    Purpose: write an unsigned integer in 7-bit groups, least significant
+        first, with the high bit of each byte set if more bytes follow.
+
+    Parameters:
+        unsigned char *out - where to write, with room for MAX_VARINT_BYTES
+        uint32_t value - value to write
+
+    Returns: size_t - number of bytes written
+*/
+static size_t put_varint (unsigned char *out, uint32_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        out[n++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    out[n++] = value;
+
+    return n;
+}
+
+/* get_varint
+    Purpose: read an unsigned integer written by put_varint
+
+    Parameters:
+        unsigned char **in - pointer to where to read from, which will be
+            moved past the integer
+        unsigned char *end - end of the bytes that may be read
+        uint32_t *value - pointer to value read, this value will be set
+
+    Returns: int - 0, or EBADMSG if the integer runs past end or is longer
+        than put_varint makes one
+*/
+static int get_varint (unsigned char **in, unsigned char *end, 
+    uint32_t *value)
+{
+    unsigned shift = 0;
+    *value = 0;
+
+    for (;;) {
+        if (*in >= end || shift >= 7 * MAX_VARINT_BYTES) {
+            return EBADMSG;
+        }
+
+        unsigned char byte = *(*in)++;
+        *value |= (uint32_t) (byte & 0x7f) << shift;
+        shift += 7;
+
+        if (!(byte & 0x80)) {
+            return 0;
+        }
+    }
+}
+
+/* max_tile_size
+    Purpose: Get the most bytes encode_tile can take for a tile. Tables
+        take at most two varints per symbol, and each symbol adds less than
+        PROB_BITS bits to the coder's output.
+
+    Parameters: See entropy.h for more info.
+*/
+size_t max_tile_size (size_t length, PackingScheme_T pc)
+{
+    unsigned widths[NUM_FIELDS] = {
+        pc.a_width, pc.b_width, pc.c_width, pc.d_width, pc.pb_width, 
+        pc.pr_width
+    };
+
+    size_t table_bound = 0;
+    int f;
+    for (f = 0; f < NUM_FIELDS; f++) {
+        assert(widths[f] > 0 && widths[f] <= MAX_FIELD_WIDTH);
+        table_bound += MAX_VARINT_BYTES * (2 * ((size_t) 1 << widths[f]) + 
+            1);
+    }
+
+    return table_bound + NUM_FIELDS * length * 2 + 4;
+}
+
+/* encode_tile
+    Purpose: Entropy code a tile of codewords. Each field of the packing
+        scheme is coded with its own frequency table, which is stored at the
+        start of the tile, so every tile can be decoded on its own. The
+        tile is encoded in the calling thread's working memory and only
+        then given memory of its own, of exactly its size.
+
+    Parameters:
+        uint32_t *codewords - array of length codewords
+        size_t length - number of codewords in the tile
+        PackingScheme_T pc - where each field is stored in a codeword
+        Arena_T arena - arena to take the encoded tile from, or NULL
+        size_t *size - pointer to size of the encoded tile in bytes, this
+            value will be set
+
+    Returns: unsigned char * - encoded tile, from arena or else to be freed
+        with free()
+
+    Errors: Throws an error if it cannot allocate memory or if a field of
+        the packing scheme is wider than 12 bits.
+*/
+unsigned char *encode_tile (uint32_t *codewords, size_t length,
+    PackingScheme_T pc, Arena_T arena, size_t *size)
+{
+    assert(codewords != NULL || length == 0);
+    assert(size != NULL);
+
+    struct Coder_Memory *memory = coder_memory();
+    struct Model *models = memory->models;
+    uint32_t *counts = memory->counts;
+
+    get_fields(pc, models);
+
+    /* the tables come first, and take up less than what max_tile_size
+        leaves for them in front of the stream */
+    size_t stream_bound = NUM_FIELDS * length * 2 + 4;
+
+    unsigned char *scratch = coder_scratch(memory, 
+        max_tile_size(length, pc));
+    size_t used = 0;
+
+    /* count every field's symbols and write its table */
+    int f;
+    for (f = 0; f < NUM_FIELDS; f++) {
+        struct Model *model = &models[f];
+        memset(counts, 0, model->symbols * sizeof(*counts));
+
+        size_t i;
+        for (i = 0; i < length; i++) {
+            counts[field_of(codewords[i], model)]++;
+        }
+
+        if (length > 0) {
+            normalize_model(model, counts, length);
+        }
+
+        unsigned s, present = 0;
+        for (s = 0; s < model->symbols; s++) {
+            present += (length > 0 && model->frequency[s] > 0);
+        }
+
+        used += put_varint(&scratch[used], present);
+
+        unsigned previous = 0;
+        for (s = 0; s < model->symbols && present > 0; s++) {
+            if (model->frequency[s] > 0) {
+                used += put_varint(&scratch[used], s - previous);
+                used += put_varint(&scratch[used], model->frequency[s] - 1);
+                previous = s + 1;
+            }
+        }
+    }
+
+    /* rANS works backwards: the last symbol is encoded first, so that
+        decoding gives symbols in order. The stream is written from the end
+        of its space towards the start. */
+    unsigned char *stream_end = &scratch[used + stream_bound];
+    unsigned char *out = stream_end;
+    uint32_t state = RANS_LOW;
+
+    size_t i = length;
+    while (i-- > 0) {
+        for (f = NUM_FIELDS - 1; f >= 0; f--) {
+            struct Model *model = &models[f];
+            uint32_t s = field_of(codewords[i], model);
+            uint32_t frequency = model->frequency[s];
+
+            uint32_t state_max = ((RANS_LOW >> PROB_BITS) << 8) * frequency;
+            while (state >= state_max) {
+                *--out = state & 0xff;
+                state >>= 8;
+            }
+
+            state = ((state / frequency) << PROB_BITS) + 
+                (state % frequency) + model->cumulative[s];
+        }
+    }
+
+    int b;
+    for (b = 3; b >= 0; b--) {
+        *--out = state >> (8 * b);
+    }
+
+    /* copy the tables and the stream out, one just after the other */
+    size_t stream_size = stream_end - out;
+    size_t tile_size = used + stream_size;
+
+    unsigned char *tile = arena != NULL ? Arena_alloc(arena, tile_size) :
+        malloc(tile_size);
+    assert(tile != NULL);
+
+    memcpy(tile, scratch, used);
+    memcpy(&tile[used], out, stream_size);
+
+    *size = tile_size;
+    return tile;
+}
+
+/* decode_tile
+    Purpose: Decode a tile made by encode_tile. Safe to call on different
+        tiles from several threads at once.
+
+    Parameters:
+        unsigned char *bytes - encoded tile
+        size_t size - size of the encoded tile in bytes
+        PackingScheme_T pc - where each field is stored in a codeword
+        uint32_t *codewords - array of length codewords, these values will
+            be set
+        size_t length - number of codewords in the tile
+
+    Returns: int - 0, or EBADMSG if the tile is malformed or too short for
+        length codewords
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+int decode_tile (unsigned char *bytes, size_t size, PackingScheme_T pc,
+    uint32_t *codewords, size_t length)
+{
+    assert(bytes != NULL || size == 0);
+    assert(codewords != NULL || length == 0);
+
+    struct Coder_Memory *memory = coder_memory();
+    struct Model *models = memory->models;
+    uint16_t *slots = memory->slots;
+
+    get_fields(pc, models);
+
+    unsigned char *in = bytes;
+    unsigned char *end = bytes + size;
+
+    /* read every field's table, and make a table from each of the
+        PROB_SCALE slots to the symbol it belongs to */
+    int f;
+    for (f = 0; f < NUM_FIELDS; f++) {
+        struct Model *model = &models[f];
+        uint16_t *slot = &slots[(size_t) f * PROB_SCALE];
+
+        memset(model->frequency, 0, model->symbols * sizeof(uint32_t));
+
+        uint32_t present;
+        if (get_varint(&in, end, &present) != 0 || 
+            present > model->symbols) {
+            return EBADMSG;
+        }
+
+        uint32_t s = 0, sum = 0;
+        uint32_t k;
+        for (k = 0; k < present; k++) {
+            uint32_t gap, frequency;
+            if (get_varint(&in, end, &gap) != 0 || 
+                get_varint(&in, end, &frequency) != 0 ||
+                gap >= model->symbols - s || 
+                frequency >= PROB_SCALE - sum) {
+                return EBADMSG;
+            }
+
+            s += gap;
+            frequency++;
+
+            model->frequency[s] = frequency;
+            model->cumulative[s] = sum;
+
+            uint32_t j;
+            for (j = 0; j < frequency; j++) {
+                slot[sum + j] = s;
+            }
+
+            sum += frequency;
+            s++;
+        }
+
+        if (sum != PROB_SCALE && (present != 0 || length != 0)) {
+            return EBADMSG;
+        }
+    }
+
+    if (length > 0 && end - in < 4) {
+        return EBADMSG;
+    }
+
+    uint32_t state = 0;
+    int b;
+    for (b = 0; b < 4 && length > 0; b++) {
+        state |= (uint32_t) *in++ << (8 * b);
+    }
+
+    size_t i;
+    for (i = 0; i < length; i++) {
+        uint32_t codeword = 0;
+
+        for (f = 0; f < NUM_FIELDS; f++) {
+            struct Model *model = &models[f];
+
+            uint32_t s = slots[(size_t) f * PROB_SCALE + 
+                (state & (PROB_SCALE - 1))];
+            codeword |= s << model->lsb;
+
+            state = model->frequency[s] * (state >> PROB_BITS) + 
+                (state & (PROB_SCALE - 1)) - model->cumulative[s];
+
+            while (state < RANS_LOW) {
+                if (in >= end) {
+                    return EBADMSG;
+                }
+                state = (state << 8) | *in++;
+            }
+        }
+
+        codewords[i] = codeword;
+    }
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+   entropy.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for entropy coding tiles of codewords with rANS, as
+       stored in format 3 compressed images. Coding is lossless: a decoded
+       tile has exactly the codewords that were encoded.
+*/
+#ifndef ENTROPY_INCLUDED
+#define ENTROPY_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "codewords.h"
+#include "arena.h"
+
+/* encode_tile
+    Purpose: Entropy code a tile of codewords. Each field of the packing
+        scheme is coded with its own frequency table, which is stored at the
+        start of the tile, so every tile can be decoded on its own. The
+        tile is encoded in the calling thread's working memory and only
+        then given memory of its own, of exactly its size.
+
+    Parameters:
+        uint32_t *codewords - array of length codewords
+        size_t length - number of codewords in the tile
+        PackingScheme_T pc - where each field is stored in a codeword
+        Arena_T arena - arena to take the encoded tile from, or NULL
+        size_t *size - pointer to size of the encoded tile in bytes, this
+            value will be set
+
+    Returns: unsigned char * - encoded tile, from arena or else to be freed
+        with free()
+
+    Errors: Throws an error if it cannot allocate memory or if a field of
+        the packing scheme is wider than 12 bits.
+*/
+unsigned char *encode_tile (uint32_t *codewords, size_t length,
+        PackingScheme_T pc, Arena_T arena, size_t *size);
+
+/* decode_tile
+    Purpose: Decode a tile made by encode_tile. Safe to call on different
+        tiles from several threads at once.
+
+    Parameters:
+        unsigned char *bytes - encoded tile
+        size_t size - size of the encoded tile in bytes
+        PackingScheme_T pc - where each field is stored in a codeword
+        uint32_t *codewords - array of length codewords, these values will
+            be set
+        size_t length - number of codewords in the tile
+
+    Returns: int - 0, or EBADMSG if the tile is malformed or too short for
+        length codewords
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+int decode_tile (unsigned char *bytes, size_t size, PackingScheme_T pc,
+        uint32_t *codewords, size_t length);
+
+/* max_tile_size
+    Purpose: Get the most bytes encode_tile can take for a tile, so that a
+        reader can tell that a tile index is wrong before it reads a tile.
+
+    Parameters:
+        size_t length - number of codewords in the tile
+        PackingScheme_T pc - where each field is stored in a codeword
+
+    Returns: size_t - size in bytes no tile of length codewords is over
+
+    Errors: Throws an error if a field of the packing scheme is wider than
+        12 bits.
+*/
+size_t max_tile_size (size_t length, PackingScheme_T pc);
+
+#endif
@@ -0,0 +1,1153 @@
+/*
+   fixed.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Functions for compressing and decompressing rows of blocks using
+       only integer (16.16 fixed-point) arithmetic. Every value that the
+       double-precision code keeps in [0, 1] or [-0.5, 0.5] is kept here as
+       an integer scaled by ONE, so 1.0 is 65536. Every value fits in 32
+       bits, so the AVX2 kernels work on eight pixels or four blocks at a
+       time, and give exactly the same results as the scalar code.
+*/
+#include "fixed.h"
+#include "chroma.h"
+
+#include <assert.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS 1
+#endif
+
+#define COMPRESS_BLOCK_SIZE 2
+
+#define FRACTION_BITS 16
+#define ONE (1 << FRACTION_BITS)
+
+/* Bits of a sum of four fixed-point values that are below 1.0 */
+#define SUM4_BITS (FRACTION_BITS + 2)
+
+/* Conversion coefficients have COEF_BITS fraction bits. A 16.16 value
+    times a coefficient then takes at most 31 bits, and white's luminance
+    (the largest sum) exactly 2^31, which still fits in an unsigned. */
+#define COEF_BITS 15
+#define COEF_HALF (1 << (COEF_BITS - 1))
+
+/* 0.3, the same MAX_BCD as codewords.c and dct.c, as an exact fraction */
+#define MAX_BCD_NUMERATOR 3
+#define MAX_BCD_DENOMINATOR 10
+
+/* Widest b, c or d field whose products still fit in 32 bits */
+#define MAX_BCD_WIDTH 12
+
+/* Widest a field whose products still fit in 32 bits */
+#define MAX_A_WIDTH 12
+
+/* The coefficients of rgb_to_cv and cv_to_rgb times 1 << COEF_BITS,
+    rounded so that the Y coefficients add up to 1 << COEF_BITS and the
+    chroma coefficients add up to zero, as they do in the real numbers */
+#define Y_R 9798
+#define Y_G 19235
+#define Y_B 3735
+#define PB_R (-5529)
+#define PB_G (-10855)
+#define PB_B 16384
+#define PR_R 16384
+#define PR_G (-13720)
+#define PR_B (-2664)
+
+#define R_PR 45941
+#define G_PB 11277
+#define G_PR 23401
+#define B_PB 58065
+
+/* Number of pixels of a scanline converted by each pass of the AVX2
+    loops, or FIXED_BLOCKS blocks of a row */
+#define AVX2_PIXELS 8
+#define FIXED_BLOCKS (AVX2_PIXELS / 2)
+
+/* sum_thresholds[k] is the smallest sum of four fixed-point chromas whose
+    average chroma_to_index puts above index k, so a block's index is the
+    number of thresholds at or below its sum, with no division and no
+    float. fixed_chroma[i] is chroma_values[i] in fixed point. Filled in
+    once by init_fixed_tables. */
+static int32_t sum_thresholds[CHROMA_LEVELS - 1];
+static int32_t fixed_chroma[CHROMA_LEVELS];
+static pthread_once_t fixed_once = PTHREAD_ONCE_INIT;
+
+/* The coefficients of rgb_to_cv times ONE / denominator, in COEF_BITS
+    fixed point, so that a sample times its coefficient is its term of the
+    16.16 converted value with COEF_BITS more fraction bits. Multiplying by
+    these replaces dividing every sample by the denominator. */
+struct Fixed_Scale {
+    uint32_t y_r, y_g, y_b;
+    int32_t pb_r, pb_g, pb_b;
+    int32_t pr_r, pr_g, pr_b;
+};
+
+/* How a packing scheme quantizes a block, worked out once per row */
+struct Fixed_Quantizer {
+    int32_t a_max;
+    int32_t b_scale, c_scale, d_scale;      /* multipliers of double_to_int */
+    int32_t b_limit, c_limit, d_limit;      /* quantized MAX_BCD */
+};
+
+/* The dequantizers of a packing scheme in COEF_BITS fixed point: a field
+    times its multiplier is its 16.16 value with COEF_BITS more fraction
+    bits */
+struct Fixed_Dequantizer {
+    int32_t a, b, c, d;
+};
+
+/* divide_round
+    Purpose: divide two integers, rounding to the nearest integer with halves
+        rounded away from zero, like round() does.
+
+    Parameters:
+        int64_t n - numerator
+        int64_t d - denominator, must be positive
+
+    Returns: int64_t - n / d, rounded
+*/
+static inline int64_t divide_round (int64_t n, int64_t d)
+{
+    if (n < 0) {
+        return -((-n + d / 2) / d);
+    }
+    return (n + d / 2) / d;
+}
+
+/* scale_coef
+    Purpose: drop the extra COEF_BITS fraction bits of a product of a
+        coefficient, rounding to the nearest integer (halves round up).
+
+    Parameters: int32_t n - product to scale
+
+    Returns: int32_t - n / (1 << COEF_BITS), rounded
+*/
+static inline int32_t scale_coef (int32_t n)
+{
+    /* >> on a negative number floors with gcc, which is what we want */
+    return (n + COEF_HALF) >> COEF_BITS;
+}
+
+/* clamp_int
+    Purpose: make sure an integer stays within a specified range
+
+    Parameters:
+        int32_t value - value to clamp
+        int32_t min - minimum of range
+        int32_t max - maximum of range
+
+    Returns: int32_t - clamped value
+*/
+static inline int32_t clamp_int (int32_t value, int32_t min, int32_t max)
+{
+    if (value < min) {
+        return min;
+    } else if (value > max) {
+        return max;
+    }
+
+    return value;
+}
+
+/* make_fixed_tables
+    Purpose: fill in sum_thresholds and fixed_chroma from the chroma tables.
+        A float threshold times 4 * ONE is exact, so a sum is at or above
+        its ceiling exactly when the average, sum / (4 * ONE), which is
+        also exact in a float, is at or above the threshold. Called once,
+        by pthread_once.
+*/
+static void make_fixed_tables (void)
+{
+    init_chroma_tables();
+
+    int k;
+    for (k = 0; k < CHROMA_LEVELS - 1; k++) {
+        double sum = (double) chroma_thresholds[k] * (4 * ONE);
+        int32_t threshold = (int32_t) sum;
+
+        sum_thresholds[k] = threshold < sum ? threshold + 1 : threshold;
+    }
+
+    for (k = 0; k < CHROMA_LEVELS; k++) {
+        fixed_chroma[k] = divide_round(
+            (int64_t) (index_to_chroma(k) * (double) (1 << 24)),
+            1 << (24 - FRACTION_BITS));
+    }
+}
+
+/* init_fixed_tables
+    Purpose: make sure sum_thresholds and fixed_chroma are filled in. Safe
+        to call any number of times from any thread.
+*/
+static inline void init_fixed_tables (void)
+{
+    pthread_once(&fixed_once, make_fixed_tables);
+}
+
+/* fixed_scale
+    Purpose: work out the conversion coefficients for a denominator. Y_G
+        takes up the rounding of the others so that white converts to a
+        luminance of ONE, and Pb's blue and Pr's red coefficients so that
+        grays have no chroma.
+
+    Parameters: unsigned denominator - denominator of the image
+
+    Returns: struct Fixed_Scale - coefficients for the denominator
+*/
+static struct Fixed_Scale fixed_scale (unsigned denominator)
+{
+    struct Fixed_Scale scale;
+
+    scale.y_r = divide_round((int64_t) Y_R * ONE, denominator);
+    scale.y_b = divide_round((int64_t) Y_B * ONE, denominator);
+    scale.y_g = divide_round((int64_t) ONE << COEF_BITS, denominator) -
+        scale.y_r - scale.y_b;
+
+    scale.pb_r = divide_round((int64_t) PB_R * ONE, denominator);
+    scale.pb_g = divide_round((int64_t) PB_G * ONE, denominator);
+    scale.pb_b = -(scale.pb_r + scale.pb_g);
+
+    scale.pr_g = divide_round((int64_t) PR_G * ONE, denominator);
+    scale.pr_b = divide_round((int64_t) PR_B * ONE, denominator);
+    scale.pr_r = -(scale.pr_g + scale.pr_b);
+
+    return scale;
+}
+
+/* bcd_scale
+    Purpose: get the multiplier double_to_int quantizes a b, c or d value
+        of a given width with, ((1 << (width - 1)) - 1) / MAX_BCD, truncated
+
+    Parameters: unsigned width - how many bits the value is stored in
+
+    Returns: int32_t - the multiplier
+*/
+static inline int32_t bcd_scale (unsigned width)
+{
+    assert(width > 1 && width <= MAX_BCD_WIDTH);
+
+    return ((1 << (width - 1)) - 1) * MAX_BCD_DENOMINATOR /
+        MAX_BCD_NUMERATOR;
+}
+
+/* fixed_quantizer
+    Purpose: work out how a packing scheme quantizes a block
+
+    Parameters: PackingScheme_T pc - packing scheme
+
+    Returns: struct Fixed_Quantizer - its multipliers and limits
+*/
+static struct Fixed_Quantizer fixed_quantizer (PackingScheme_T pc)
+{
+    assert(pc.a_width <= MAX_A_WIDTH);
+    assert(pc.pb_width <= 4 && pc.pr_width <= 4);
+
+    struct Fixed_Quantizer quantizer = {
+        .a_max = (1 << pc.a_width) - 1,
+        .b_scale = bcd_scale(pc.b_width),
+        .c_scale = bcd_scale(pc.c_width),
+        .d_scale = bcd_scale(pc.d_width)
+    };
+
+    /* dct.c clamps to MAX_BCD before quantizing */
+    quantizer.b_limit = quantizer.b_scale * MAX_BCD_NUMERATOR /
+        MAX_BCD_DENOMINATOR;
+    quantizer.c_limit = quantizer.c_scale * MAX_BCD_NUMERATOR /
+        MAX_BCD_DENOMINATOR;
+    quantizer.d_limit = quantizer.d_scale * MAX_BCD_NUMERATOR /
+        MAX_BCD_DENOMINATOR;
+
+    return quantizer;
+}
+
+/* Component video of one pixel in fixed point */
+struct Fixed_CV {
+    int32_t y, pb, pr;
+};
+
+/* rgb_to_fixed_cv
+    Purpose: Convert the samples of a pixel to fixed-point component video.
+
+    Parameters:
+        uint32_t r, g, b - the pixel's samples, at most the denominator
+        struct Fixed_Scale *scale - coefficients for the image's denominator
+
+    Returns: struct Fixed_CV - converted pixel
+*/
+static inline struct Fixed_CV rgb_to_fixed_cv (uint32_t r, uint32_t g,
+    uint32_t b, struct Fixed_Scale *scale)
+{
+    /* the luminance's terms are all positive and can add up to 2^31, so
+        they are added as unsigneds */
+    uint32_t y = r * scale->y_r + g * scale->y_g + b * scale->y_b;
+
+    struct Fixed_CV cv = {
+        .y = (y + COEF_HALF) >> COEF_BITS,
+        .pb = scale_coef((int32_t) r * scale->pb_r +
+            (int32_t) g * scale->pb_g + (int32_t) b * scale->pb_b),
+        .pr = scale_coef((int32_t) r * scale->pr_r +
+            (int32_t) g * scale->pr_g + (int32_t) b * scale->pr_b)
+    };
+
+    return cv;
+}
+
+/* quantize_bcd
+    Purpose: quantize four times a fixed-point b, c or d value the way
+        double_to_int does after dct.c clamps it to [-MAX_BCD, MAX_BCD].
+
+    Parameters:
+        int32_t sum4 - four times the value, in fixed point
+        int32_t scale - multiplier of double_to_int for the field's width
+        int32_t limit - largest quantized value
+
+    Returns: int32_t - quantized value
+*/
+static inline int32_t quantize_bcd (int32_t sum4, int32_t scale,
+    int32_t limit)
+{
+    /* C division truncates towards zero, like the cast in double_to_int */
+    return clamp_int(sum4 * scale / (4 * ONE), -limit, limit);
+}
+
+/* chroma_index
+    Purpose: quantize the average of a block's four fixed-point chromas to
+        the index chroma_to_index gives the same average.
+
+    Parameters: int32_t sum4 - sum of the four chromas
+
+    Returns: unsigned - index of the closest quantized chroma
+*/
+static inline unsigned chroma_index (int32_t sum4)
+{
+    unsigned index = 0;
+
+    int k;
+    for (k = 0; k < CHROMA_LEVELS - 1; k++) {
+        index += (sum4 >= sum_thresholds[k]);
+    }
+
+    return index;
+}
+
+/* block_codeword
+    Purpose: Quantize and pack a 2x2 block of fixed-point pixels.
+
+    Parameters:
+        struct Fixed_CV pix1 - top-left pixel
+        struct Fixed_CV pix2 - top-right pixel
+        struct Fixed_CV pix3 - bottom-left pixel
+        struct Fixed_CV pix4 - bottom-right pixel
+        struct Fixed_Quantizer *q - how the packing scheme quantizes
+        PackingScheme_T pc - how values should be packed into the codeword
+
+    Returns: uint32_t - the block's codeword
+*/
+static inline uint32_t block_codeword (struct Fixed_CV pix1,
+    struct Fixed_CV pix2, struct Fixed_CV pix3, struct Fixed_CV pix4,
+    struct Fixed_Quantizer *q, PackingScheme_T pc)
+{
+    int32_t a4 = pix4.y + pix3.y + pix2.y + pix1.y;
+    int32_t b4 = pix4.y + pix3.y - pix2.y - pix1.y;
+    int32_t c4 = pix4.y - pix3.y + pix2.y - pix1.y;
+    int32_t d4 = pix4.y - pix3.y - pix2.y + pix1.y;
+
+    /* a4 is never negative, so rounding half up is rounding like round() */
+    int32_t a = (a4 * q->a_max + (1 << (SUM4_BITS - 1))) >> SUM4_BITS;
+
+    Codeword_Fields fields = {
+        .a = clamp_int(a, 0, q->a_max),
+        .b = quantize_bcd(b4, q->b_scale, q->b_limit),
+        .c = quantize_bcd(c4, q->c_scale, q->c_limit),
+        .d = quantize_bcd(d4, q->d_scale, q->d_limit),
+        .pb_index = chroma_index(pix1.pb + pix2.pb + pix3.pb + pix4.pb),
+        .pr_index = chroma_index(pix1.pr + pix2.pr + pix3.pr + pix4.pr)
+    };
+
+    return pack_fields(fields, pc);
+}
+
+/* rgb_rows_fixed_scalar
+    Purpose: Compress a row of blocks of Pnm_rgb pixels one block at a
+        time. Used when AVX2 is not available, and for the blocks left over
+        at the end of a row by rgb_rows_fixed_avx2.
+
+    Parameters: See compress_rows_fixed for more info, and
+        struct Fixed_Scale *scale - coefficients for the denominator
+        struct Fixed_Quantizer *q - how the packing scheme quantizes
+*/
+static void rgb_rows_fixed_scalar (struct Pnm_rgb *top,
+    struct Pnm_rgb *bottom, unsigned length, unsigned denominator,
+    struct Fixed_Scale *scale, struct Fixed_Quantizer *q, PackingScheme_T pc,
+    uint32_t *codewords)
+{
+    struct Pnm_rgb *pixels[4];
+    struct Fixed_CV cv[4];
+
+    unsigned col;
+    for (col = 0; col < length; col++) {
+        unsigned l = col * COMPRESS_BLOCK_SIZE;
+
+        /* top-left, top-right, bottom-left, bottom-right */
+        pixels[0] = &top[l];
+        pixels[1] = &top[l + 1];
+        pixels[2] = &bottom[l];
+        pixels[3] = &bottom[l + 1];
+
+        int k;
+        for (k = 0; k < 4; k++) {
+            /* samples above the denominator would overflow */
+            cv[k] = rgb_to_fixed_cv(
+                pixels[k]->red < denominator ? pixels[k]->red : denominator,
+                pixels[k]->green < denominator ?
+                    pixels[k]->green : denominator,
+                pixels[k]->blue < denominator ?
+                    pixels[k]->blue : denominator,
+                scale);
+        }
+
+        codewords[col] = block_codeword(cv[0], cv[1], cv[2], cv[3], q, pc);
+    }
+}
+
+/* packed_rows_fixed_scalar
+    Purpose: Compress a row of blocks of packed 8-bit RGB pixels one block
+        at a time. Used when AVX2 is not available, and for the blocks left
+        over at the end of a row by packed_rows_fixed_avx2.
+
+    Parameters: See compress_packed_rows_fixed for more info, and
+        struct Fixed_Scale *scale - coefficients for the denominator
+        struct Fixed_Quantizer *q - how the packing scheme quantizes
+*/
+static void packed_rows_fixed_scalar (unsigned char *top,
+    unsigned char *bottom, unsigned length, struct Fixed_Scale *scale,
+    struct Fixed_Quantizer *q, PackingScheme_T pc, uint32_t *codewords)
+{
+    unsigned char *pixels[4];
+    struct Fixed_CV cv[4];
+
+    unsigned col;
+    for (col = 0; col < length; col++) {
+        unsigned l = 6 * col;
+
+        pixels[0] = &top[l];
+        pixels[1] = &top[l + 3];
+        pixels[2] = &bottom[l];
+        pixels[3] = &bottom[l + 3];
+
+        int k;
+        for (k = 0; k < 4; k++) {
+            cv[k] = rgb_to_fixed_cv(pixels[k][0], pixels[k][1],
+                pixels[k][2], scale);
+        }
+
+        codewords[col] = block_codeword(cv[0], cv[1], cv[2], cv[3], q, pc);
+    }
+}
+
+#ifdef HAVE_AVX2_KERNELS
+
+/* Fixed-point component video of eight pixels, one per lane */
+struct Fixed_CV8 {
+    __m256i y, pb, pr;
+};
+
+/* rgb_to_fixed_cv_avx2
+    Purpose: Convert eight pixels to fixed-point component video at once,
+        like rgb_to_fixed_cv.
+
+    Parameters:
+        __m256i r, g, b - the pixels' samples, one per 32-bit lane
+        struct Fixed_Scale *scale - coefficients for the denominator
+
+    Returns: struct Fixed_CV8 - the converted pixels
+*/
+__attribute__((target("avx2")))
+static inline struct Fixed_CV8 rgb_to_fixed_cv_avx2 (__m256i r, __m256i g,
+    __m256i b, struct Fixed_Scale *scale)
+{
+    const __m256i half = _mm256_set1_epi32(COEF_HALF);
+    struct Fixed_CV8 cv;
+
+    /* luminance is shifted as an unsigned, like the scalar code */
+    cv.y = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(
+        _mm256_add_epi32(
+        _mm256_mullo_epi32(r, _mm256_set1_epi32(scale->y_r)),
+        _mm256_mullo_epi32(g, _mm256_set1_epi32(scale->y_g))),
+        _mm256_mullo_epi32(b, _mm256_set1_epi32(scale->y_b))), half),
+        COEF_BITS);
+
+    cv.pb = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(
+        _mm256_add_epi32(
+        _mm256_mullo_epi32(r, _mm256_set1_epi32(scale->pb_r)),
+        _mm256_mullo_epi32(g, _mm256_set1_epi32(scale->pb_g))),
+        _mm256_mullo_epi32(b, _mm256_set1_epi32(scale->pb_b))), half),
+        COEF_BITS);
+
+    cv.pr = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(
+        _mm256_add_epi32(
+        _mm256_mullo_epi32(r, _mm256_set1_epi32(scale->pr_r)),
+        _mm256_mullo_epi32(g, _mm256_set1_epi32(scale->pr_g))),
+        _mm256_mullo_epi32(b, _mm256_set1_epi32(scale->pr_b))), half),
+        COEF_BITS);
+
+    return cv;
+}
+
+/* packed_to_fixed_cv_avx2
+    Purpose: Convert eight pixels of packed 8-bit RGB to fixed-point
+        component video at once. Reads 28 bytes, four more than the pixels
+        take up.
+
+    Parameters:
+        unsigned char *row - first byte of the eight pixels
+        struct Fixed_Scale *scale - coefficients for the denominator
+
+    Returns: struct Fixed_CV8 - the converted pixels
+*/
+__attribute__((target("avx2")))
+static inline struct Fixed_CV8 packed_to_fixed_cv_avx2 (unsigned char *row,
+    struct Fixed_Scale *scale)
+{
+    /* spread every third byte of each half into its own 32-bit lane */
+    const __m256i reds = _mm256_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1,
+        6, -1, -1, -1, 9, -1, -1, -1, 0, -1, -1, -1, 3, -1, -1, -1,
+        6, -1, -1, -1, 9, -1, -1, -1);
+    const __m256i greens = _mm256_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1,
+        7, -1, -1, -1, 10, -1, -1, -1, 1, -1, -1, -1, 4, -1, -1, -1,
+        7, -1, -1, -1, 10, -1, -1, -1);
+    const __m256i blues = _mm256_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1,
+        8, -1, -1, -1, 11, -1, -1, -1, 2, -1, -1, -1, 5, -1, -1, -1,
+        8, -1, -1, -1, 11, -1, -1, -1);
+
+    /* pixels 0-3 in the low half and 4-7 in the high half */
+    __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(
+        _mm_loadu_si128((__m128i *) row)),
+        _mm_loadu_si128((__m128i *) (row + 12)), 1);
+
+    return rgb_to_fixed_cv_avx2(_mm256_shuffle_epi8(bytes, reds),
+        _mm256_shuffle_epi8(bytes, greens),
+        _mm256_shuffle_epi8(bytes, blues), scale);
+}
+
+/* pnm_to_fixed_cv_avx2
+    Purpose: Convert eight Pnm_rgb pixels to fixed-point component video at
+        once.
+
+    Parameters:
+        struct Pnm_rgb *row - first of the eight pixels
+        unsigned denominator - denominator of the image
+        struct Fixed_Scale *scale - coefficients for the denominator
+
+    Returns: struct Fixed_CV8 - the converted pixels
+*/
+__attribute__((target("avx2")))
+static inline struct Fixed_CV8 pnm_to_fixed_cv_avx2 (struct Pnm_rgb *row,
+    unsigned denominator, struct Fixed_Scale *scale)
+{
+    /* A Pnm_rgb is three unsigneds, so the reds of eight pixels are three
+        ints apart, with green and blue just after them */
+    const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i max = _mm256_set1_epi32(denominator);
+    const int *base = (const int *) row;
+
+    /* samples above the denominator would overflow */
+    return rgb_to_fixed_cv_avx2(
+        _mm256_min_epu32(_mm256_i32gather_epi32(base, stride, 4), max),
+        _mm256_min_epu32(_mm256_i32gather_epi32(base + 1, stride, 4), max),
+        _mm256_min_epu32(_mm256_i32gather_epi32(base + 2, stride, 4), max),
+        scale);
+}
+
+/* pair_sums_avx2
+    Purpose: Add up the two pixels of each of four blocks in an upper and a
+        lower scanline, or subtract the right pixel from the left one.
+
+    Parameters:
+        __m256i top - values of eight pixels of the upper scanline
+        __m256i bottom - values of the same pixels of the lower scanline
+        int subtract - 0 to add, or 1 to subtract
+
+    Returns: __m256i - the four blocks' upper results in the low half, and
+        their lower results in the high half
+*/
+__attribute__((target("avx2")))
+static inline __m256i pair_sums_avx2 (__m256i top, __m256i bottom,
+    int subtract)
+{
+    /* hadd and hsub work within halves, giving blocks 0, 1 of top, 0, 1 of
+        bottom, then 2, 3 of top and 2, 3 of bottom */
+    const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+
+    __m256i pairs = subtract ? _mm256_hsub_epi32(top, bottom) :
+        _mm256_hadd_epi32(top, bottom);
+
+    return _mm256_permutevar8x32_epi32(pairs, order);
+}
+
+/* quantize_bcd_avx2
+    Purpose: Quantize four b, c or d values at once, like quantize_bcd.
+
+    Parameters:
+        __m128i sum4 - four times each value, in fixed point
+        int32_t scale - multiplier of double_to_int for the field's width
+        int32_t limit - largest quantized value
+
+    Returns: __m128i - quantized values
+*/
+__attribute__((target("avx2")))
+static inline __m128i quantize_bcd_avx2 (__m128i sum4, int32_t scale,
+    int32_t limit)
+{
+    __m128i product = _mm_mullo_epi32(sum4, _mm_set1_epi32(scale));
+
+    /* divide the magnitude and put the sign back, which truncates towards
+        zero like C division */
+    __m128i quotient = _mm_sign_epi32(_mm_srli_epi32(
+        _mm_abs_epi32(product), SUM4_BITS), product);
+
+    return _mm_min_epi32(_mm_max_epi32(quotient, _mm_set1_epi32(-limit)),
+        _mm_set1_epi32(limit));
+}
+
+/* chroma_index_avx2
+    Purpose: Quantize the chroma of four blocks at once, like chroma_index.
+
+    Parameters: __m128i sum4 - sum of each block's four chromas
+
+    Returns: __m128i - the blocks' indices
+*/
+__attribute__((target("avx2")))
+static inline __m128i chroma_index_avx2 (__m128i sum4)
+{
+    __m128i index = _mm_setzero_si128();
+
+    /* a compare that holds gives -1, so subtracting it counts it */
+    int k;
+    for (k = 0; k < CHROMA_LEVELS - 1; k++) {
+        index = _mm_sub_epi32(index, _mm_cmpgt_epi32(sum4,
+            _mm_set1_epi32(sum_thresholds[k] - 1)));
+    }
+
+    return index;
+}
+
+/* pack_field_avx2
+    Purpose: Put four quantized values in their field of four codewords.
+
+    Parameters:
+        __m128i value - the values, which fit in width bits as signed or
+            unsigned integers
+        unsigned width - width of the field
+        unsigned lsb - position of the field's least significant bit
+
+    Returns: __m128i - the codewords' bits for the field
+*/
+__attribute__((target("avx2")))
+static inline __m128i pack_field_avx2 (__m128i value, unsigned width,
+    unsigned lsb)
+{
+    __m128i mask = _mm_set1_epi32((int32_t) (((uint64_t) 1 << width) - 1));
+
+    return _mm_sll_epi32(_mm_and_si128(value, mask),
+        _mm_cvtsi32_si128(lsb));
+}
+
+/* blocks_codewords_avx2
+    Purpose: Quantize and pack four 2x2 blocks at once, like block_codeword,
+        and store their codewords.
+
+    Parameters:
+        struct Fixed_CV8 top - eight pixels of the upper scanline
+        struct Fixed_CV8 bottom - the same pixels of the lower scanline
+        struct Fixed_Quantizer *q - how the packing scheme quantizes
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - where to store the four codewords
+*/
+__attribute__((target("avx2")))
+static inline void blocks_codewords_avx2 (struct Fixed_CV8 top,
+    struct Fixed_CV8 bottom, struct Fixed_Quantizer *q, PackingScheme_T pc,
+    uint32_t *codewords)
+{
+    /* left + right and left - right of each block's upper and lower pair */
+    __m256i sums = pair_sums_avx2(top.y, bottom.y, 0);
+    __m256i diffs = pair_sums_avx2(top.y, bottom.y, 1);
+
+    __m128i top_sum = _mm256_castsi256_si128(sums);
+    __m128i bottom_sum = _mm256_extracti128_si256(sums, 1);
+    __m128i top_diff = _mm256_castsi256_si128(diffs);
+    __m128i bottom_diff = _mm256_extracti128_si256(diffs, 1);
+
+    __m128i a4 = _mm_add_epi32(bottom_sum, top_sum);
+    __m128i b4 = _mm_sub_epi32(bottom_sum, top_sum);
+    __m128i c4 = _mm_sub_epi32(_mm_setzero_si128(),
+        _mm_add_epi32(bottom_diff, top_diff));
+    __m128i d4 = _mm_sub_epi32(top_diff, bottom_diff);
+
+    __m128i a = _mm_srli_epi32(_mm_add_epi32(
+        _mm_mullo_epi32(a4, _mm_set1_epi32(q->a_max)),
+        _mm_set1_epi32(1 << (SUM4_BITS - 1))), SUM4_BITS);
+    a = _mm_min_epi32(a, _mm_set1_epi32(q->a_max));
+
+    __m256i pb = pair_sums_avx2(top.pb, bottom.pb, 0);
+    __m256i pr = pair_sums_avx2(top.pr, bottom.pr, 0);
+
+    __m128i pb_index = chroma_index_avx2(_mm_add_epi32(
+        _mm256_castsi256_si128(pb), _mm256_extracti128_si256(pb, 1)));
+    __m128i pr_index = chroma_index_avx2(_mm_add_epi32(
+        _mm256_castsi256_si128(pr), _mm256_extracti128_si256(pr, 1)));
+
+    __m128i words = _mm_or_si128(_mm_or_si128(_mm_or_si128(
+        pack_field_avx2(a, pc.a_width, pc.a_lsb),
+        pack_field_avx2(quantize_bcd_avx2(b4, q->b_scale, q->b_limit),
+            pc.b_width, pc.b_lsb)),
+        _mm_or_si128(
+        pack_field_avx2(quantize_bcd_avx2(c4, q->c_scale, q->c_limit),
+            pc.c_width, pc.c_lsb),
+        pack_field_avx2(quantize_bcd_avx2(d4, q->d_scale, q->d_limit),
+            pc.d_width, pc.d_lsb))),
+        _mm_or_si128(pack_field_avx2(pb_index, pc.pb_width, pc.pb_lsb),
+        pack_field_avx2(pr_index, pc.pr_width, pc.pr_lsb)));
+
+    _mm_storeu_si128((__m128i *) codewords, words);
+}
+
+/* rgb_rows_fixed_avx2
+    Purpose: Compress a row of blocks of Pnm_rgb pixels four blocks at a
+        time using AVX2.
+
+    Parameters: See rgb_rows_fixed_scalar for more info.
+*/
+__attribute__((target("avx2")))
+static void rgb_rows_fixed_avx2 (struct Pnm_rgb *top, struct Pnm_rgb *bottom,
+    unsigned length, unsigned denominator, struct Fixed_Scale *scale,
+    struct Fixed_Quantizer *q, PackingScheme_T pc, uint32_t *codewords)
+{
+    unsigned col;
+    for (col = 0; col + FIXED_BLOCKS <= length; col += FIXED_BLOCKS) {
+        unsigned l = col * COMPRESS_BLOCK_SIZE;
+
+        blocks_codewords_avx2(
+            pnm_to_fixed_cv_avx2(&top[l], denominator, scale),
+            pnm_to_fixed_cv_avx2(&bottom[l], denominator, scale), q, pc,
+            &codewords[col]);
+    }
+
+    unsigned l = col * COMPRESS_BLOCK_SIZE;
+    rgb_rows_fixed_scalar(&top[l], &bottom[l], length - col, denominator,
+        scale, q, pc, &codewords[col]);
+}
+
+/* packed_rows_fixed_avx2
+    Purpose: Compress a row of blocks of packed 8-bit RGB pixels four blocks
+        at a time using AVX2. The last load of each scanline in a pass reads
+        four bytes past the pass's pixels, so the vector loop stops while at
+        least one more block is left and never reads past the row.
+
+    Parameters: See packed_rows_fixed_scalar for more info.
+*/
+__attribute__((target("avx2")))
+static void packed_rows_fixed_avx2 (unsigned char *top, unsigned char *bottom,
+    unsigned length, struct Fixed_Scale *scale, struct Fixed_Quantizer *q,
+    PackingScheme_T pc, uint32_t *codewords)
+{
+    unsigned col;
+    for (col = 0; col + FIXED_BLOCKS + 1 <= length; col += FIXED_BLOCKS) {
+        unsigned l = 6 * col;
+
+        blocks_codewords_avx2(packed_to_fixed_cv_avx2(&top[l], scale),
+            packed_to_fixed_cv_avx2(&bottom[l], scale), q, pc,
+            &codewords[col]);
+    }
+
+    packed_rows_fixed_scalar(&top[6 * col], &bottom[6 * col], length - col,
+        scale, q, pc, &codewords[col]);
+}
+
+#endif
+
+/* compress_rows_fixed
+    Purpose: Compress a pair of scanlines into a row of codewords, one per
+        2x2 block, using fixed-point arithmetic. If the rows have an odd
+        width, the last column is ignored. Uses AVX2 when the processor has
+        it; the results are the same either way.
+
+    Parameters:
+        struct Pnm_rgb *top - upper scanline of at least 2 * length pixels
+        struct Pnm_rgb *bottom - lower scanline of at least 2 * length pixels
+        unsigned length - number of blocks (and codewords) in the row
+        unsigned denominator - denominator of the image the pixels belong to
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - array of length codewords, these values will be
+            set
+*/
+void compress_rows_fixed (struct Pnm_rgb *top, struct Pnm_rgb *bottom,
+    unsigned length, unsigned denominator, PackingScheme_T pc,
+    uint32_t *codewords)
+{
+    assert(denominator > 0);
+    init_fixed_tables();
+
+    struct Fixed_Scale scale = fixed_scale(denominator);
+    struct Fixed_Quantizer q = fixed_quantizer(pc);
+
+#ifdef HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2")) {
+        rgb_rows_fixed_avx2(top, bottom, length, denominator, &scale, &q,
+            pc, codewords);
+        return;
+    }
+#endif
+
+    rgb_rows_fixed_scalar(top, bottom, length, denominator, &scale, &q, pc,
+        codewords);
+}
+
+/* compress_packed_rows_fixed
+    Purpose: Compress a pair of scanlines of packed 8-bit RGB, as stored in a
+        raw PPM, into a row of codewords using fixed-point arithmetic. Gives
+        the same codewords as compress_rows_fixed on the same pixels, but
+        lets the scanlines be read straight from a memory-mapped file. If
+        the rows have an odd width, the last column is ignored.
+
+    Parameters:
+        unsigned char *top - upper scanline of at least 6 * length bytes
+        unsigned char *bottom - lower scanline of at least 6 * length bytes
+        unsigned length - number of blocks (and codewords) in the row
+        unsigned denominator - denominator of the image, less than 256
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - array of length codewords, these values will be
+            set
+*/
+void compress_packed_rows_fixed (unsigned char *top, unsigned char *bottom,
+    unsigned length, unsigned denominator, PackingScheme_T pc,
+    uint32_t *codewords)
+{
+    assert(denominator > 0 && denominator < 256);
+    init_fixed_tables();
+
+    struct Fixed_Scale scale = fixed_scale(denominator);
+    struct Fixed_Quantizer q = fixed_quantizer(pc);
+
+#ifdef HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2")) {
+        packed_rows_fixed_avx2(top, bottom, length, &scale, &q, pc,
+            codewords);
+        return;
+    }
+#endif
+
+    packed_rows_fixed_scalar(top, bottom, length, &scale, &q, pc, codewords);
+}
+
+/* fixed_dequantizer
+    Purpose: work out how a packing scheme's fields are dequantized: a by
+        uint_to_double and b, c and d by int_to_double.
+
+    Parameters: PackingScheme_T pc - packing scheme
+
+    Returns: struct Fixed_Dequantizer - multipliers of the fields
+*/
+static struct Fixed_Dequantizer fixed_dequantizer (PackingScheme_T pc)
+{
+    assert(pc.a_width <= MAX_A_WIDTH);
+    assert(pc.b_width <= MAX_BCD_WIDTH && pc.c_width <= MAX_BCD_WIDTH &&
+        pc.d_width <= MAX_BCD_WIDTH);
+    assert(pc.pb_width <= 4 && pc.pr_width <= 4);
+
+    int64_t one = (int64_t) ONE << COEF_BITS;
+
+    struct Fixed_Dequantizer dq = {
+        .a = divide_round(one, ((int64_t) 1 << pc.a_width) - 1),
+        .b = divide_round(one * MAX_BCD_NUMERATOR,
+            MAX_BCD_DENOMINATOR * ((int64_t) 1 << (pc.b_width - 1))),
+        .c = divide_round(one * MAX_BCD_NUMERATOR,
+            MAX_BCD_DENOMINATOR * ((int64_t) 1 << (pc.c_width - 1))),
+        .d = divide_round(one * MAX_BCD_NUMERATOR,
+            MAX_BCD_DENOMINATOR * ((int64_t) 1 << (pc.d_width - 1)))
+    };
+
+    return dq;
+}
+
+/* fixed_to_byte
+    Purpose: clamp a fixed-point RGB value to [0, 1] and scale it by a
+        denominator, truncating like cv_to_rgb does.
+
+    Parameters:
+        int32_t value - value to convert
+        int denominator - value to scale by, at most 255
+
+    Returns: unsigned char - scaled value
+*/
+static inline unsigned char fixed_to_byte (int32_t value, int denominator)
+{
+    return (clamp_int(value, 0, ONE) * denominator) >> FRACTION_BITS;
+}
+
+/* decompress_rows_fixed_scalar
+    Purpose: Decompress a row of codewords one at a time. Used when AVX2 is
+        not available, and for the codewords left over at the end of a row
+        by decompress_rows_fixed_avx2.
+
+    Parameters: See decompress_rows_fixed for more info, and
+        struct Fixed_Dequantizer *dq - multipliers of the fields
+*/
+static void decompress_rows_fixed_scalar (uint32_t *codewords,
+    unsigned length, PackingScheme_T pc, struct Fixed_Dequantizer *dq,
+    int denominator, unsigned char *top, unsigned char *bottom)
+{
+    unsigned col;
+    for (col = 0; col < length; col++) {
+        Codeword_Fields fields = unpack_fields(codewords[col], pc);
+
+        /* a is never negative, and b, c and d are scaled as signed */
+        int32_t a = ((uint32_t) fields.a * dq->a + COEF_HALF) >> COEF_BITS;
+        int32_t b = scale_coef(fields.b * dq->b);
+        int32_t c = scale_coef(fields.c * dq->c);
+        int32_t d = scale_coef(fields.d * dq->d);
+
+        int32_t y[4] = {
+            a - b - c + d,
+            a - b + c - d,
+            a + b - c - d,
+            a + b + c + d
+        };
+
+        int32_t pb = fixed_chroma[fields.pb_index];
+        int32_t pr = fixed_chroma[fields.pr_index];
+
+        int32_t r_offset = scale_coef(R_PR * pr);
+        int32_t g_offset = scale_coef(G_PB * pb + G_PR * pr);
+        int32_t b_offset = scale_coef(B_PB * pb);
+
+        /* top-left, top-right, bottom-left, bottom-right */
+        unsigned char *out[4] = {
+            &top[6 * col], &top[6 * col + 3],
+            &bottom[6 * col], &bottom[6 * col + 3]
+        };
+
+        int k;
+        for (k = 0; k < 4; k++) {
+            out[k][0] = fixed_to_byte(y[k] + r_offset, denominator);
+            out[k][1] = fixed_to_byte(y[k] - g_offset, denominator);
+            out[k][2] = fixed_to_byte(y[k] + b_offset, denominator);
+        }
+    }
+}
+
+#ifdef HAVE_AVX2_KERNELS
+
+/* get_field_avx2
+    Purpose: Get a field of four codewords at once.
+
+    Parameters:
+        __m128i words - the codewords
+        unsigned width - width of the field
+        unsigned lsb - position of the field's least significant bit
+        int is_signed - 1 to sign-extend the field, 0 to zero-extend it
+
+    Returns: __m128i - the field of each codeword
+*/
+__attribute__((target("avx2")))
+static inline __m128i get_field_avx2 (__m128i words, unsigned width,
+    unsigned lsb, int is_signed)
+{
+    /* move the field to the top of each lane, then back down */
+    __m128i high = _mm_sll_epi32(words, _mm_cvtsi32_si128(32 - width - lsb));
+    __m128i down = _mm_cvtsi32_si128(32 - width);
+
+    return is_signed ? _mm_sra_epi32(high, down) : _mm_srl_epi32(high, down);
+}
+
+/* scale_coef_avx2
+    Purpose: drop the extra COEF_BITS fraction bits of four products at
+        once, like scale_coef.
+
+    Parameters: __m128i n - products to scale
+
+    Returns: __m128i - the products / (1 << COEF_BITS), rounded
+*/
+__attribute__((target("avx2")))
+static inline __m128i scale_coef_avx2 (__m128i n)
+{
+    return _mm_srai_epi32(_mm_add_epi32(n, _mm_set1_epi32(COEF_HALF)),
+        COEF_BITS);
+}
+
+/* store_rgb_avx2
+    Purpose: Scale four fixed-point RGB pixels by a denominator, truncating
+        like fixed_to_byte, and store them as 12 packed bytes.
+
+    Parameters:
+        __m128i r, g, b - the pixels' values, one per lane
+        __m128i denominator - value to scale by, in every lane
+        unsigned char *rgb - where to store the 12 bytes
+*/
+__attribute__((target("avx2")))
+static inline void store_rgb_avx2 (__m128i r, __m128i g, __m128i b,
+    __m128i denominator, unsigned char *rgb)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(ONE);
+
+    r = _mm_srli_epi32(_mm_mullo_epi32(_mm_min_epi32(_mm_max_epi32(r, zero),
+        one), denominator), FRACTION_BITS);
+    g = _mm_srli_epi32(_mm_mullo_epi32(_mm_min_epi32(_mm_max_epi32(g, zero),
+        one), denominator), FRACTION_BITS);
+    b = _mm_srli_epi32(_mm_mullo_epi32(_mm_min_epi32(_mm_max_epi32(b, zero),
+        one), denominator), FRACTION_BITS);
+
+    /* narrow to bytes laid out as rrrrggggbbbb, then shuffle them into
+        rgbrgbrgbrgb order */
+    __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(r, g),
+        _mm_packs_epi32(b, zero));
+
+    const __m128i interleave = _mm_setr_epi8(0, 4, 8, 1, 5, 9, 2, 6, 10,
+        3, 7, 11, 12, 13, 14, 15);
+    bytes = _mm_shuffle_epi8(bytes, interleave);
+
+    _mm_storel_epi64((__m128i *) rgb, bytes);
+    *(int32_t *) (rgb + 8) = _mm_extract_epi32(bytes, 2);
+}
+
+/* store_pixels_avx2
+    Purpose: Store the four pixels of one scanline of two blocks, given
+        their luminances and the blocks' chroma offsets.
+
+    Parameters:
+        __m128i left - the blocks' left pixels' luminances, in lanes 0, 1
+            or 2, 3
+        __m128i right - the blocks' right pixels' luminances, likewise
+        __m128i offsets[3] - the blocks' red, green and blue offsets,
+            likewise
+        int high - 0 to store the blocks in lanes 0, 1, 1 for lanes 2, 3
+        __m128i denominator - value to scale by, in every lane
+        unsigned char *rgb - where to store the 12 bytes
+*/
+__attribute__((target("avx2")))
+static inline void store_pixels_avx2 (__m128i left, __m128i right,
+    __m128i offsets[3], int high, __m128i denominator, unsigned char *rgb)
+{
+    __m128i y = high ? _mm_unpackhi_epi32(left, right) :
+        _mm_unpacklo_epi32(left, right);
+
+    __m128i off[3];
+    int k;
+    for (k = 0; k < 3; k++) {
+        off[k] = high ? _mm_unpackhi_epi32(offsets[k], offsets[k]) :
+            _mm_unpacklo_epi32(offsets[k], offsets[k]);
+    }
+
+    store_rgb_avx2(_mm_add_epi32(y, off[0]), _mm_sub_epi32(y, off[1]),
+        _mm_add_epi32(y, off[2]), denominator, rgb);
+}
+
+/* decompress_rows_fixed_avx2
+    Purpose: Decompress a row of codewords four at a time using AVX2.
+
+    Parameters: See decompress_rows_fixed_scalar for more info.
+*/
+__attribute__((target("avx2")))
+static void decompress_rows_fixed_avx2 (uint32_t *codewords,
+    unsigned length, PackingScheme_T pc, struct Fixed_Dequantizer *dq,
+    int denominator, unsigned char *top, unsigned char *bottom)
+{
+    const __m128i denom = _mm_set1_epi32(denominator);
+    const __m128i half = _mm_set1_epi32(COEF_HALF);
+
+    unsigned col;
+    for (col = 0; col + FIXED_BLOCKS <= length; col += FIXED_BLOCKS) {
+        __m128i words = _mm_loadu_si128((__m128i *) &codewords[col]);
+
+        __m128i a = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(
+            get_field_avx2(words, pc.a_width, pc.a_lsb, 0),
+            _mm_set1_epi32(dq->a)), half), COEF_BITS);
+        __m128i b = scale_coef_avx2(_mm_mullo_epi32(
+            get_field_avx2(words, pc.b_width, pc.b_lsb, 1),
+            _mm_set1_epi32(dq->b)));
+        __m128i c = scale_coef_avx2(_mm_mullo_epi32(
+            get_field_avx2(words, pc.c_width, pc.c_lsb, 1),
+            _mm_set1_epi32(dq->c)));
+        __m128i d = scale_coef_avx2(_mm_mullo_epi32(
+            get_field_avx2(words, pc.d_width, pc.d_lsb, 1),
+            _mm_set1_epi32(dq->d)));
+
+        __m128i a_minus_b = _mm_sub_epi32(a, b);
+        __m128i a_plus_b = _mm_add_epi32(a, b);
+        __m128i c_minus_d = _mm_sub_epi32(c, d);
+        __m128i c_plus_d = _mm_add_epi32(c, d);
+
+        /* a - b - c + d, a - b + c - d, a + b - c - d, a + b + c + d */
+        __m128i y1 = _mm_sub_epi32(a_minus_b, c_minus_d);
+        __m128i y2 = _mm_add_epi32(a_minus_b, c_minus_d);
+        __m128i y3 = _mm_sub_epi32(a_plus_b, c_plus_d);
+        __m128i y4 = _mm_add_epi32(a_plus_b, c_plus_d);
+
+        __m128i pb = _mm_i32gather_epi32(fixed_chroma,
+            get_field_avx2(words, pc.pb_width, pc.pb_lsb, 0), 4);
+        __m128i pr = _mm_i32gather_epi32(fixed_chroma,
+            get_field_avx2(words, pc.pr_width, pc.pr_lsb, 0), 4);
+
+        __m128i offsets[3] = {
+            scale_coef_avx2(_mm_mullo_epi32(pr, _mm_set1_epi32(R_PR))),
+            scale_coef_avx2(_mm_add_epi32(
+                _mm_mullo_epi32(pb, _mm_set1_epi32(G_PB)),
+                _mm_mullo_epi32(pr, _mm_set1_epi32(G_PR)))),
+            scale_coef_avx2(_mm_mullo_epi32(pb, _mm_set1_epi32(B_PB)))
+        };
+
+        unsigned char *upper = &top[6 * col];
+        unsigned char *lower = &bottom[6 * col];
+
+        store_pixels_avx2(y1, y2, offsets, 0, denom, upper);
+        store_pixels_avx2(y1, y2, offsets, 1, denom, upper + 12);
+        store_pixels_avx2(y3, y4, offsets, 0, denom, lower);
+        store_pixels_avx2(y3, y4, offsets, 1, denom, lower + 12);
+    }
+
+    decompress_rows_fixed_scalar(&codewords[col], length - col, pc, dq,
+        denominator, &top[6 * col], &bottom[6 * col]);
+}
+
+#endif
+
+/* decompress_rows_fixed
+    Purpose: Decompress a row of codewords into a pair of scanlines of packed
+        8-bit RGB using fixed-point arithmetic. Uses AVX2 when the processor
+        has it; the results are the same either way.
+
+    Parameters:
+        uint32_t *codewords - array of length codewords
+        unsigned length - number of codewords (and blocks) in the row
+        PackingScheme_T pc - how values are stored in each codeword
+        int denominator - value to scale RGB values by, at most 255
+        unsigned char *top - upper scanline of 6 * length bytes, these values
+            will be set
+        unsigned char *bottom - lower scanline of 6 * length bytes, these
+            values will be set
+*/
+void decompress_rows_fixed (uint32_t *codewords, unsigned length,
+    PackingScheme_T pc, int denominator,
+    unsigned char *top, unsigned char *bottom)
+{
+    assert(denominator > 0 && denominator < 256);
+    init_fixed_tables();
+
+    struct Fixed_Dequantizer dq = fixed_dequantizer(pc);
+
+#ifdef HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2")) {
+        decompress_rows_fixed_avx2(codewords, length, pc, &dq, denominator,
+            top, bottom);
+        return;
+    }
+#endif
+
+    decompress_rows_fixed_scalar(codewords, length, pc, &dq, denominator,
+        top, bottom);
+}
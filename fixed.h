@@ -0,0 +1,71 @@
+/*
+   fixed.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for compressing and decompressing rows of blocks using
+       only integer (16.16 fixed-point) arithmetic. The codewords use the
+       same format as the double-precision code in fused.c.
+*/
+#ifndef FIXED_INCLUDED
+#define FIXED_INCLUDED
+
+#include <stdint.h>
+#include <pnm.h>
+
+#include "codewords.h"
+
+/* compress_rows_fixed
+    Purpose: Compress a pair of scanlines into a row of codewords, one per
+        2x2 block, using fixed-point arithmetic. If the rows have an odd
+        width, the last column is ignored.
+
+    Parameters:
+        struct Pnm_rgb *top - upper scanline of at least 2 * length pixels
+        struct Pnm_rgb *bottom - lower scanline of at least 2 * length pixels
+        unsigned length - number of blocks (and codewords) in the row
+        unsigned denominator - denominator of the image the pixels belong to
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - array of length codewords, these values will
+            be set
+*/
+void compress_rows_fixed (struct Pnm_rgb *top, struct Pnm_rgb *bottom,
+        unsigned length, unsigned denominator, PackingScheme_T pc,
+        uint32_t *codewords);
+
+/* compress_packed_rows_fixed
+    Purpose: Compress a pair of scanlines of packed 8-bit RGB, as stored in
+        a raw PPM, into a row of codewords using fixed-point arithmetic.
+        Gives the same codewords as compress_rows_fixed on the same pixels.
+
+    Parameters:
+        unsigned char *top - upper scanline of at least 6 * length bytes
+        unsigned char *bottom - lower scanline of at least 6 * length bytes
+        unsigned length - number of blocks (and codewords) in the row
+        unsigned denominator - denominator of the image, less than 256
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - array of length codewords, these values will
+            be set
+*/
+void compress_packed_rows_fixed (unsigned char *top, unsigned char *bottom,
+        unsigned length, unsigned denominator, PackingScheme_T pc,
+        uint32_t *codewords);
+
+/* decompress_rows_fixed
+    Purpose: Decompress a row of codewords into a pair of scanlines of packed
+        8-bit RGB using fixed-point arithmetic.
+
+    Parameters:
+        uint32_t *codewords - array of length codewords
+        unsigned length - number of codewords (and blocks) in the row
+        PackingScheme_T pc - how values are stored in each codeword
+        int denominator - value to scale RGB values by, at most 255
+        unsigned char *top - upper scanline of 6 * length bytes, these
+            values will be set
+        unsigned char *bottom - lower scanline of 6 * length bytes, these
+            values will be set
+*/
+void decompress_rows_fixed (uint32_t *codewords, unsigned length,
+        PackingScheme_T pc, int denominator,
+        unsigned char *top, unsigned char *bottom);
+
+#endif
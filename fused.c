@@ -0,0 +1,215 @@
+/*
+   fused.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Functions for compressing and decompressing images in a single
+       pass, turning each 2x2 block of RGB pixels straight into a codeword
+       and back without building component video or DCT arrays in between.
+*/
+#include "fused.h"
+#include "chroma.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#define COMPRESS_BLOCK_SIZE 2
+
+/* compress_rows and decompress_rows convert this many blocks' worth of pixels
+    between RGB and component video at a time, so their planes fit on the
+    stack and stay in cache */
+#define CHUNK_BLOCKS 64
+#define CHUNK_PIXELS (CHUNK_BLOCKS * COMPRESS_BLOCK_SIZE)
+
+/* compress_chunk
+    Purpose: Compress a chunk of a row of blocks that has already been
+        converted to component video planes. Used by compress_rows and
+        compress_packed_rows.
+
+    Parameters:
+        CV_Planes *planes - component video of the chunk
+        unsigned blocks - number of blocks (and codewords) in the chunk
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - array of blocks codewords, these values will be
+            set
+*/
+static void compress_chunk (CV_Planes *planes, unsigned blocks,
+    PackingScheme_T pc, uint32_t *codewords)
+{
+    unsigned col;
+    for (col = 0; col < blocks; col++) {
+        codewords[col] = pack_codeword(calculate_ABCD(planes, col), pc);
+    }
+}
+
+/* compress_rows
+    Purpose: Compress a pair of scanlines into a row of codewords, one per
+        2x2 block. If the rows have an odd width, the last column is ignored,
+        so the image never has to be copied into a trimmed array. Pixels are
+        converted a chunk of the row at a time with rgb_row_to_cv, which is
+        vectorized, into planes holding a luminance per pixel and a Pb and
+        Pr per block.
+
+    Parameters:
+        struct Pnm_rgb *top - upper scanline of at least 2 * length pixels
+        struct Pnm_rgb *bottom - lower scanline of at least 2 * length pixels
+        unsigned length - number of blocks (and codewords) in the row
+        unsigned denominator - denominator of the image the pixels belong to
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - array of length codewords, these values will be
+            set
+*/
+void compress_rows (struct Pnm_rgb *top, struct Pnm_rgb *bottom,
+    unsigned length, unsigned denominator, PackingScheme_T pc,
+    uint32_t *codewords)
+{
+    double top_y[CHUNK_PIXELS], bottom_y[CHUNK_PIXELS];
+    float pb[CHUNK_BLOCKS], pr[CHUNK_BLOCKS];
+    CV_Planes planes = { top_y, bottom_y, pb, pr };
+
+    init_chroma_tables();
+
+    unsigned start;
+    for (start = 0; start < length; start += CHUNK_BLOCKS) {
+        unsigned blocks = length - start < CHUNK_BLOCKS ? 
+            length - start : CHUNK_BLOCKS;
+        unsigned left = start * COMPRESS_BLOCK_SIZE;
+
+        rgb_row_to_cv(&top[left], &bottom[left], blocks, denominator, 
+            &planes);
+        compress_chunk(&planes, blocks, pc, &codewords[start]);
+    }
+}
+
+/* compress_packed_rows
+    Purpose: Compress a pair of scanlines of packed 8-bit RGB, as stored in a
+        raw PPM, into a row of codewords. Gives the same codewords as
+        compress_rows on the same pixels, but lets the scanlines be read
+        straight from a memory-mapped file. If the rows have an odd width,
+        the last column is ignored.
+
+    Parameters:
+        unsigned char *top - upper scanline of at least 6 * length bytes
+        unsigned char *bottom - lower scanline of at least 6 * length bytes
+        unsigned length - number of blocks (and codewords) in the row
+        unsigned denominator - denominator of the image, less than 256
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - array of length codewords, these values will be
+            set
+*/
+void compress_packed_rows (unsigned char *top, unsigned char *bottom,
+    unsigned length, unsigned denominator, PackingScheme_T pc,
+    uint32_t *codewords)
+{
+    double top_y[CHUNK_PIXELS], bottom_y[CHUNK_PIXELS];
+    float pb[CHUNK_BLOCKS], pr[CHUNK_BLOCKS];
+    CV_Planes planes = { top_y, bottom_y, pb, pr };
+
+    assert(denominator > 0 && denominator < 256);
+    init_chroma_tables();
+
+    unsigned start;
+    for (start = 0; start < length; start += CHUNK_BLOCKS) {
+        unsigned blocks = length - start < CHUNK_BLOCKS ? 
+            length - start : CHUNK_BLOCKS;
+        unsigned left = start * COMPRESS_BLOCK_SIZE;
+
+        packed_row_to_cv(&top[3 * left], &bottom[3 * left], blocks, 
+            denominator, &planes);
+        compress_chunk(&planes, blocks, pc, &codewords[start]);
+    }
+}
+
+/* decompress_rows
+    Purpose: Decompress a row of codewords into a pair of scanlines of packed
+        8-bit RGB. Codewords are unpacked a chunk of the row at a time into
+        planes holding a luminance per pixel and a Pb and Pr per block,
+        which cv_row_to_rgb converts to RGB with vector instructions.
+
+    Parameters:
+        uint32_t *codewords - array of length codewords
+        unsigned length - number of codewords (and blocks) in the row
+        PackingScheme_T pc - how values are stored in each codeword
+        int denominator - value to scale RGB values by, at most 255
+        unsigned char *top - upper scanline of 6 * length bytes, these values
+            will be set
+        unsigned char *bottom - lower scanline of 6 * length bytes, these
+            values will be set
+*/
+void decompress_rows (uint32_t *codewords, unsigned length,
+    PackingScheme_T pc, int denominator,
+    unsigned char *top, unsigned char *bottom)
+{
+    double top_y[CHUNK_PIXELS], bottom_y[CHUNK_PIXELS];
+    float pb[CHUNK_BLOCKS], pr[CHUNK_BLOCKS];
+    CV_Planes planes = { top_y, bottom_y, pb, pr };
+
+    init_chroma_tables();
+
+    unsigned start;
+    for (start = 0; start < length; start += CHUNK_BLOCKS) {
+        unsigned blocks = length - start < CHUNK_BLOCKS ? 
+            length - start : CHUNK_BLOCKS;
+
+        unsigned col;
+        for (col = 0; col < blocks; col++) {
+            calculate_Ys(unpack_codeword(codewords[start + col], pc), 
+                &planes, col);
+        }
+
+        unsigned left = start * COMPRESS_BLOCK_SIZE;
+        unsigned pixels = blocks * COMPRESS_BLOCK_SIZE;
+
+        cv_row_to_rgb(top_y, pb, pr, pixels, COMPRESS_BLOCK_SIZE, 
+            denominator, &top[3 * left]);
+        cv_row_to_rgb(bottom_y, pb, pr, pixels, COMPRESS_BLOCK_SIZE, 
+            denominator, &bottom[3 * left]);
+    }
+}
+
+/* decompress_thumbnail_row
+    Purpose: Decompress a row of codewords into one scanline of a half-size
+        image, one pixel per block. Each pixel is the block's average
+        luminance a with its Pb and Pr, so no inverse DCT is done.
+
+    Parameters:
+        uint32_t *codewords - array of length codewords
+        unsigned length - number of codewords (and pixels) in the row
+        PackingScheme_T pc - how values are stored in each codeword
+        int denominator - value to scale RGB values by, at most 255
+        unsigned char *scanline - scanline of 3 * length bytes, these values
+            will be set
+*/
+void decompress_thumbnail_row (uint32_t *codewords, unsigned length,
+    PackingScheme_T pc, int denominator, unsigned char *scanline)
+{
+    double y[CHUNK_PIXELS];
+    float pb[CHUNK_PIXELS], pr[CHUNK_PIXELS];
+
+    /* Only three fields are needed, so they are pulled out with shifts and
+        masks rather than unpacking every field of the codeword */
+    uint32_t a_mask = ((uint64_t) 1 << pc.a_width) - 1;
+    uint32_t pb_mask = ((uint64_t) 1 << pc.pb_width) - 1;
+    uint32_t pr_mask = ((uint64_t) 1 << pc.pr_width) - 1;
+    double a_max = a_mask;
+
+    init_chroma_tables();
+
+    unsigned start;
+    for (start = 0; start < length; start += CHUNK_PIXELS) {
+        unsigned pixels = length - start < CHUNK_PIXELS ? 
+            length - start : CHUNK_PIXELS;
+
+        unsigned col;
+        for (col = 0; col < pixels; col++) {
+            uint32_t codeword = codewords[start + col];
+
+            /* the same value uint_to_double gives for a */
+            y[col] = (double) ((codeword >> pc.a_lsb) & a_mask) / a_max;
+            pb[col] = index_to_chroma((codeword >> pc.pb_lsb) & pb_mask);
+            pr[col] = index_to_chroma((codeword >> pc.pr_lsb) & pr_mask);
+        }
+
+        cv_row_to_rgb(y, pb, pr, pixels, 1, denominator, 
+            &scanline[3 * start]);
+    }
+}
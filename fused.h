@@ -0,0 +1,88 @@
+/*
+   fused.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for compressing and decompressing images in a single
+       pass, turning each 2x2 block of RGB pixels straight into a codeword
+       and back without building component video or DCT arrays in between.
+*/
+#ifndef FUSED_INCLUDED
+#define FUSED_INCLUDED
+
+#include <stdint.h>
+#include <pnm.h>
+
+#include "color_conversion.h"
+#include "dct.h"
+#include "codewords.h"
+
+/* compress_rows
+    Purpose: Compress a pair of scanlines into a row of codewords, one per
+        2x2 block. If the rows have an odd width, the last column is ignored.
+
+    Parameters:
+        struct Pnm_rgb *top - upper scanline of at least 2 * length pixels
+        struct Pnm_rgb *bottom - lower scanline of at least 2 * length pixels
+        unsigned length - number of blocks (and codewords) in the row
+        unsigned denominator - denominator of the image the pixels belong to
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - array of length codewords, these values will
+            be set
+*/
+void compress_rows (struct Pnm_rgb *top, struct Pnm_rgb *bottom,
+        unsigned length, unsigned denominator, PackingScheme_T pc,
+        uint32_t *codewords);
+
+/* compress_packed_rows
+    Purpose: Compress a pair of scanlines of packed 8-bit RGB, as stored in a
+        raw PPM, into a row of codewords. Gives the same codewords as
+        compress_rows on the same pixels. If the rows have an odd width, the
+        last column is ignored.
+
+    Parameters:
+        unsigned char *top - upper scanline of at least 6 * length bytes
+        unsigned char *bottom - lower scanline of at least 6 * length bytes
+        unsigned length - number of blocks (and codewords) in the row
+        unsigned denominator - denominator of the image, less than 256
+        PackingScheme_T pc - how values should be packed into each codeword
+        uint32_t *codewords - array of length codewords, these values will
+            be set
+*/
+void compress_packed_rows (unsigned char *top, unsigned char *bottom,
+        unsigned length, unsigned denominator, PackingScheme_T pc,
+        uint32_t *codewords);
+
+/* decompress_rows
+    Purpose: Decompress a row of codewords into a pair of scanlines of packed
+        8-bit RGB.
+
+    Parameters:
+        uint32_t *codewords - array of length codewords
+        unsigned length - number of codewords (and blocks) in the row
+        PackingScheme_T pc - how values are stored in each codeword
+        int denominator - value to scale RGB values by, at most 255
+        unsigned char *top - upper scanline of 6 * length bytes, these
+            values will be set
+        unsigned char *bottom - lower scanline of 6 * length bytes, these
+            values will be set
+*/
+void decompress_rows (uint32_t *codewords, unsigned length,
+        PackingScheme_T pc, int denominator,
+        unsigned char *top, unsigned char *bottom);
+
+/* decompress_thumbnail_row
+    Purpose: Decompress a row of codewords into one scanline of a half-size
+        image, one pixel per block, from each block's a, Pb and Pr alone.
+
+    Parameters:
+        uint32_t *codewords - array of length codewords
+        unsigned length - number of codewords (and pixels) in the row
+        PackingScheme_T pc - how values are stored in each codeword
+        int denominator - value to scale RGB values by, at most 255
+        unsigned char *scanline - scanline of 3 * length bytes, these
+            values will be set
+*/
+void decompress_thumbnail_row (uint32_t *codewords, unsigned length,
+        PackingScheme_T pc, int denominator, unsigned char *scanline);
+
+#endif
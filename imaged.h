@@ -0,0 +1,64 @@
+/*
+   imaged.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Protocol spoken by 40imaged, the compression daemon, over its
+       Unix domain socket.
+
+       A client connects and sends any number of jobs, one after the
+       other. Each job is an Imaged_Request, sent with sendmsg, which may
+       carry file descriptors as SCM_RIGHTS ancillary data:
+           - no descriptors: the input follows the request inline, in
+             request.length bytes, and the result comes back inline
+           - one descriptor: the input is read from it, starting at its
+             current offset, and the result comes back inline
+           - two descriptors: the input is read from the first and the
+             result is written to the second, so no image data goes over
+             the socket
+       A regular file or memfd passed as input is memory mapped, so raw
+       PPMs are compressed without being copied.
+
+       The daemon answers every job with an Imaged_Reply, followed by
+       reply.length bytes of result when the result comes back inline.
+       After a reply with an error, such as EINVAL for a bad job or options,
+       the daemon closes the connection without reading any more. If the
+       input makes compress40 or decompress40 fail, the connection is
+       closed without a reply.
+*/
+#ifndef IMAGED_INCLUDED
+#define IMAGED_INCLUDED
+
+#include <stdint.h>
+
+/* First field of every request and reply */
+#define IMAGED_MAGIC 0x34306964u
+
+/* Jobs a request can ask for */
+#define IMAGED_COMPRESS 1
+#define IMAGED_DECOMPRESS 2
+
+/* Most file descriptors a request can carry */
+#define IMAGED_MAX_FDS 2
+
+/* Imaged_Request asks for one job. format, predictor and fixed_point mean
+        the same as 40image's --format, --predict and --fixed, and are
+        ignored when decompressing except for fixed_point. */
+typedef struct Imaged_Request {
+        uint32_t magic;
+        uint32_t job;           /* IMAGED_COMPRESS or IMAGED_DECOMPRESS */
+        uint32_t format;        /* PLAIN_FORMAT or TILED_FORMAT */
+        uint32_t predictor;     /* NO_PREDICTOR or MED_PREDICTOR */
+        uint32_t fixed_point;
+        uint32_t reserved;
+        uint64_t length;        /* bytes of input inline, if no fds */
+} Imaged_Request;
+
+/* Imaged_Reply tells how a job went. error is 0 on success, or the errno
+        of what went wrong reading the request or writing the result. */
+typedef struct Imaged_Reply {
+        uint32_t magic;
+        int32_t error;
+        uint64_t length;        /* bytes of result that follow inline */
+} Imaged_Reply;
+
+#endif
@@ -0,0 +1,39 @@
+/*
+   io.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Functions for moving whole messages over pipes and sockets,
+       used by 40image --batch and 40imaged.
+*/
+#include "io.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+/* full_io
+    Purpose: read or write all of a message on a pipe or socket.
+
+    Parameters: See io.h for more info.
+*/
+int full_io (int fd, void *bytes, size_t size, int writing)
+{
+    size_t done = 0;
+
+    while (done < size) {
+        ssize_t n = writing ? 
+            write(fd, (char *) bytes + done, size - done) :
+            read(fd, (char *) bytes + done, size - done);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+
+        done += n;
+    }
+
+    return 1;
+}
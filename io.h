@@ -0,0 +1,28 @@
+/*
+   io.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for moving whole messages over pipes and sockets,
+       shared by batch.c and 40imaged.c.
+*/
+#ifndef IO_INCLUDED
+#define IO_INCLUDED
+
+#include <stddef.h>
+
+/* full_io
+    Purpose: read or write all of a message on a pipe or socket, carrying on
+        after short transfers and interrupted calls.
+
+    Parameters:
+        int fd - descriptor to use
+        void *bytes - message
+        size_t size - size of the message
+        int writing - nonzero to write, zero to read
+
+    Returns: int - 1 if the whole message was moved, 0 if the other end
+        closed the descriptor or there was an error
+*/
+int full_io (int fd, void *bytes, size_t size, int writing);
+
+#endif
@@ -0,0 +1,43 @@
+/*
+   options.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Settings that change how compress40 and decompress40 do their
+       work. Only fixed_point, format and predictor change the bytes that
+       are written, and files written with them are still read by the
+       default pipeline: decompress40 reads the format and predictor from
+       the header. It is part of the library's interface (codec40.h), so
+       the format and predictor constants are defined here.
+*/
+#ifndef OPTIONS_INCLUDED
+#define OPTIONS_INCLUDED
+
+/* Compressed image formats: plain 32-bit codewords, and entropy coded
+        tiles of codewords with an index of where each tile ends */
+#define PLAIN_FORMAT 2
+#define TILED_FORMAT 3
+
+/* Predictors for coding a, Pb and Pr as residuals: none, or the median
+        edge detector from LOCO-I, applied by predict_codewords. Only
+        TILED_FORMAT takes MED_PREDICTOR */
+#define NO_PREDICTOR 0
+#define MED_PREDICTOR 1
+
+typedef struct Options {
+        unsigned threads;       /* number of threads to (de)compress with */
+        int fixed_point;        /* use the integer kernels in fixed.c */
+        unsigned format;        /* PLAIN_FORMAT or TILED_FORMAT to write */
+        unsigned predictor;     /* NO_PREDICTOR or MED_PREDICTOR */
+} Options_T;
+
+/* Defined in compress40.c and set by 40image from the command line */
+extern Options_T compress40_options;
+
+/* compress40_release
+    Purpose: Free the thread pool and buffers that compress40 and
+        decompress40 keep from one image to the next. Defined in
+        compress40.c.
+*/
+void compress40_release (void);
+
+#endif
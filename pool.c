@@ -0,0 +1,215 @@
+/*
+   pool.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Implementation of a fixed-size pool of worker threads that run
+       numbered jobs in parallel.
+*/
+#include "pool.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+/* Jobs are handed out one number at a time under the lock, so faster
+    threads simply take more of them. Each call of Pool_run bumps the
+    generation, which is how sleeping workers know there is new work. */
+struct Pool_T {
+    unsigned nworkers;
+    pthread_t *workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+
+    Pool_applyfun *apply;
+    void *cl;
+    unsigned njobs, next, finished;
+    unsigned long generation;
+    int shutdown;
+};
+
+/* run_jobs
+    Purpose: Take and run jobs from the current generation until there are
+        none left. Must be called with the lock held, and returns with it
+        held.
+
+    Parameters: Pool_T pool - pool to take jobs from
+*/
+static void run_jobs (Pool_T pool)
+{
+    while (pool->next < pool->njobs) {
+        unsigned job = pool->next++;
+
+        pthread_mutex_unlock(&pool->lock);
+        pool->apply(job, pool->cl);
+        pthread_mutex_lock(&pool->lock);
+
+        pool->finished++;
+        if (pool->finished == pool->njobs) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+}
+
+/* worker
+    Purpose: Body of each worker thread. Sleeps until Pool_run starts a new
+        generation of jobs or the pool is freed.
+
+    Parameters: void *arg - the pool the worker belongs to
+
+    Returns: void * - always NULL
+*/
+static void *worker (void *arg)
+{
+    Pool_T pool = arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (;;) {
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+
+        if (pool->shutdown) {
+            break;
+        }
+
+        seen = pool->generation;
+        run_jobs(pool);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/* Pool_new
+    Purpose: Create a pool that runs jobs on a given number of threads.
+
+    Parameters: unsigned nthreads - number of threads to run jobs on,
+        including the caller of Pool_run
+
+    Returns: Pool_T - new pool
+
+    Errors: Throws an error if nthreads is 0, or if it cannot allocate memory
+        or start a thread.
+*/
+Pool_T Pool_new (unsigned nthreads)
+{
+    assert(nthreads > 0);
+
+    Pool_T pool = malloc(sizeof(*pool));
+    assert(pool != NULL);
+
+    pool->nworkers = nthreads - 1;
+    pool->workers = malloc((pool->nworkers + 1) * sizeof(pthread_t));
+    assert(pool->workers != NULL);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    pool->apply = NULL;
+    pool->cl = NULL;
+    pool->njobs = pool->next = pool->finished = 0;
+    pool->generation = 0;
+    pool->shutdown = 0;
+
+    unsigned i;
+    for (i = 0; i < pool->nworkers; i++) {
+        int err = pthread_create(&pool->workers[i], NULL, worker, pool);
+        assert(err == 0);
+    }
+
+    return pool;
+}
+
+/* Pool_run
+    Purpose: Call apply once for every job number from 0 to njobs - 1, in
+        parallel, and return when all of them have finished. Jobs may run in
+        any order.
+
+    Parameters:
+        Pool_T pool - pool to run jobs on
+        unsigned njobs - number of jobs
+        Pool_applyfun apply - function to run each job
+        void *cl - closure passed to every call of apply
+*/
+void Pool_run (Pool_T pool, unsigned njobs, Pool_applyfun apply, void *cl)
+{
+    assert(pool != NULL);
+    assert(apply != NULL);
+
+    /* No need to wake anyone up when there is nobody to share work with */
+    if (pool->nworkers == 0 || njobs <= 1) {
+        unsigned job;
+        for (job = 0; job < njobs; job++) {
+            apply(job, cl);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    pool->apply = apply;
+    pool->cl = cl;
+    pool->njobs = njobs;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->generation++;
+
+    pthread_cond_broadcast(&pool->work_ready);
+
+    run_jobs(pool);
+
+    while (pool->finished < pool->njobs) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Pool_threads
+    Purpose: Get the number of threads a pool runs jobs on.
+
+    Parameters: Pool_T pool - pool to ask about
+
+    Returns: unsigned - number of threads, including the caller of Pool_run
+*/
+unsigned Pool_threads (Pool_T pool)
+{
+    assert(pool != NULL);
+    return pool->nworkers + 1;
+}
+
+/* Pool_free
+    Purpose: Stop a pool's worker threads and free the pool.
+
+    Parameters: Pool_T *pool - pointer to pool to free
+*/
+void Pool_free (Pool_T *pool)
+{
+    assert(pool != NULL && *pool != NULL);
+
+    Pool_T p = *pool;
+
+    pthread_mutex_lock(&p->lock);
+    p->shutdown = 1;
+    pthread_cond_broadcast(&p->work_ready);
+    pthread_mutex_unlock(&p->lock);
+
+    unsigned i;
+    for (i = 0; i < p->nworkers; i++) {
+        pthread_join(p->workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->work_ready);
+    pthread_cond_destroy(&p->work_done);
+
+    free(p->workers);
+    free(p);
+    *pool = NULL;
+}
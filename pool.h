@@ -0,0 +1,60 @@
+/*
+   pool.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for a fixed-size pool of worker threads that run
+       numbered jobs in parallel.
+*/
+#ifndef POOL_INCLUDED
+#define POOL_INCLUDED
+
+/* A pool of worker threads. The thread that calls Pool_run also works on
+        jobs, so a pool made for n threads starts n - 1 workers. */
+typedef struct Pool_T *Pool_T;
+
+/* Pool_applyfun is called once for every job number given to Pool_run */
+typedef void Pool_applyfun (unsigned job, void *cl);
+
+/* Pool_new
+    Purpose: Create a pool that runs jobs on a given number of threads.
+
+    Parameters: unsigned nthreads - number of threads to run jobs on,
+        including the caller of Pool_run
+
+    Returns: Pool_T - new pool
+
+    Errors: Throws an error if nthreads is 0, or if it cannot allocate memory
+        or start a thread.
+*/
+Pool_T Pool_new (unsigned nthreads);
+
+/* Pool_run
+    Purpose: Call apply once for every job number from 0 to njobs - 1, in
+        parallel, and return when all of them have finished. Jobs may run in
+        any order.
+
+    Parameters:
+        Pool_T pool - pool to run jobs on
+        unsigned njobs - number of jobs
+        Pool_applyfun apply - function to run each job
+        void *cl - closure passed to every call of apply
+*/
+void Pool_run (Pool_T pool, unsigned njobs, Pool_applyfun apply, void *cl);
+
+/* Pool_threads
+    Purpose: Get the number of threads a pool runs jobs on.
+
+    Parameters: Pool_T pool - pool to ask about
+
+    Returns: unsigned - number of threads, including the caller of Pool_run
+*/
+unsigned Pool_threads (Pool_T pool);
+
+/* Pool_free
+    Purpose: Stop a pool's worker threads and free the pool.
+
+    Parameters: Pool_T *pool - pointer to pool to free
+*/
+void Pool_free (Pool_T *pool);
+
+#endif
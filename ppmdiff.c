@@ -13,6 +13,7 @@
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2flat.h"
 #include "pnm.h"
 
 /* Used in compute_difference apply function */
@@ -117,7 +118,7 @@ int main(int argc, char const *argv[])
 {
     FILE *img1;
     FILE *img2;
-    A2Methods_T methods = uarray2_methods_plain; 
+    A2Methods_T methods = uarray2_methods_flat;
 
     assert(argc == 3);
     assert(!(strcmp(argv[1], "-") == 0 && strcmp(argv[2], "-") == 0));
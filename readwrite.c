@@ -7,181 +7,1578 @@
 */
 #include "readwrite.h"
 
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "entropy.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS 1
+#endif
+
 #define COMPRESS_BLOCK_SIZE 2
 #define CODEWORD_BYTE_SIZE 4
 
-/* copy_pixels
-    Purpose: copy_pixels from one Pnm_ppm->pixels to another. Called by
-        map_default in read_image.
+/* Format 3 tiles have about TILE_CODEWORDS codewords each, and the index
+    of where each tile ends takes TILE_INDEX_BYTE_SIZE bytes per tile */
+#define TILE_CODEWORDS 16384
+#define TILE_INDEX_BYTE_SIZE 8
+
+/* Codewords are byte-swapped into a buffer this many at a time (64 KB) and
+    each buffer is written with one fwrite */
+#define CODEWORD_CHUNK 16384
+
+/* Number of codewords in an AVX2 register */
+#define AVX2_CODEWORDS 8
+
+/* Largest denominator a PPM can have */
+#define MAX_DENOMINATOR 65535
+
+/* Ppm_Writers collect rows in a buffer of about this many bytes (1 MB) and
+    write them with one fwrite when it fills up */
+#define PPM_WRITE_BUFFER (1 << 20)
+
+/* get_memory
+    Purpose: Allocate memory for a reader or writer, from its arena if it
+        has one and with malloc if it does not.
+
+    Parameters:
+        Arena_T arena - arena to allocate from, or NULL
+        size_t size - bytes needed
+
+    Returns: void * - block of size bytes, to be given back with put_memory
+
+    Errors: Throws an error if it cannot allocate memory.
+*/
+static void *get_memory (Arena_T arena, size_t size)
+{
+    void *memory = arena != NULL ? Arena_alloc(arena, size) : malloc(size);
+    assert(memory != NULL);
+
+    return memory;
+}
+
+/* put_memory
+    Purpose: Give back memory from get_memory. Memory from an arena is only
+        taken back when the arena is reset.
+
+    Parameters:
+        Arena_T arena - arena the memory is from, or NULL
+        void *memory - memory to give back
+*/
+static void put_memory (Arena_T arena, void *memory)
+{
+    if (arena == NULL) {
+        free(memory);
+    }
+}
+
+/* skip_ppm_space
+    Purpose: skip whitespace and comments between the fields of a PPM header
+
+    Parameters: FILE *input - stream to read from
+
+    Returns: int - the first character that is not whitespace or a comment
+*/
+int skip_ppm_space (FILE *input)
+{
+    int c = getc(input);
+
+    while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        if (c == '#') {
+            while (c != '\n' && c != EOF) {
+                c = getc(input);
+            }
+        }
+        c = getc(input);
+    }
+
+    return c;
+}
+
+/* read_ppm_number
+    Purpose: read an unsigned decimal number from a PPM header or from the
+        pixels of a plain (P3) PPM
+
+    Parameters:
+        FILE *input - stream to read from
+        unsigned *n - pointer to number read, this value will be set
 
-    Parameters: See A2Methods_applyfun for more details
+    Returns: int - 0, or EBADMSG if there is no number to read or it does
+        not fit in an unsigned
 */
-void copy_pixels (int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
+int read_ppm_number (FILE *input, unsigned *n)
 {
-    (void) array2;
-    (void) elem;
+    int c = skip_ppm_space(input);
+    if (c < '0' || c > '9') {
+        return EBADMSG;
+    }
 
-    Pnm_ppm image = (Pnm_ppm) cl;
+    *n = 0;
+    while (c >= '0' && c <= '9') {
+        if (*n > (UINT_MAX - (c - '0')) / 10) {
+            return EBADMSG;
+        }
 
-    int size = image->methods->size(image->pixels);
+        *n = *n * 10 + (c - '0');
+        c = getc(input);
+    }
 
-    Pnm_rgb pixel = image->methods->at(image->pixels, i, j);
+    /* The character after a number is always whitespace. We give it back
+        in case it starts a comment. */
+    ungetc(c, input);
 
-    memcpy(elem, pixel, size);
+    return 0;
 }
 
-/* read_image
-    Purpose: Read in a Pnm_ppm from a given filename and trim its width and
-        height so that they're even.
+/* map_ppm_raster
+    Purpose: Memory map the file a raw PPM with 8-bit samples is being read
+        from and point reader->raster at its first pixel. Leaves the reader
+        unchanged if the input is not a regular file or cannot be mapped.
+        The stream itself is not moved, so read_ppm_row still works.
+
+    Parameters: Ppm_Reader reader - reader positioned at the first pixel
+
+    Returns: int - 0, or EBADMSG if the file is too short for the image
+*/
+static int map_ppm_raster (Ppm_Reader reader)
+{
+    struct stat info;
+    int fd = fileno(reader->input);
+    long offset = ftell(reader->input);
+
+    if (offset < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        return 0;
+    }
+
+    /* checking the size once here is what lets the compression kernels
+        read rows straight from the mapping */
+    uint64_t raster_size = (uint64_t) 3 * reader->width * reader->height;
+    if (info.st_size < offset || 
+        (uint64_t) (info.st_size - offset) < raster_size) {
+        return EBADMSG;
+    }
+
+    if (info.st_size == 0) {
+        return 0;
+    }
+
+    unsigned char *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE,
+        fd, 0);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    reader->map = map;
+    reader->map_size = info.st_size;
+    reader->raster = &map[offset];
+
+    return 0;
+}
+
+/* open_ppm_reader
+    Purpose: Read the header of a PPM from a given stream and return a reader
+        for its rows.
 
     Parameters:
         FILE *input - stream to read from
-        A2Methods methods - methods to operate on copy over pixels to trimmed 
-            image
+        Arena_T arena - arena to take the reader's memory from, or NULL to
+            use malloc
 
-    Returns: Pnm_ppm - trimmed image
+    Returns: Ppm_Reader - reader positioned at the first row of pixels, or
+        NULL with errno set to EINVAL if the input is not a PPM, or to
+        EBADMSG if its header is malformed or a file is too short for its
+        pixels
 
-    Errors: Throws an error if the input is NULL or cannot allocate memory. 
+    Errors: Throws an error if the input is NULL or if it cannot allocate
+        memory.
 */
-Pnm_ppm read_image (FILE *input, A2Methods_T methods)
+Ppm_Reader open_ppm_reader (FILE *input, Arena_T arena)
 {
     assert(input != NULL);
 
-    Pnm_ppm image = Pnm_ppmread(input, methods);
+    int p = getc(input);
+    int kind = getc(input);
+    if (p != 'P' || (kind != '6' && kind != '3')) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    unsigned width, height, denominator;
+    if (read_ppm_number(input, &width) != 0 || 
+        read_ppm_number(input, &height) != 0 ||
+        read_ppm_number(input, &denominator) != 0 ||
+        denominator == 0 || denominator > MAX_DENOMINATOR) {
+        errno = EBADMSG;
+        return NULL;
+    }
+
+    /* exactly one whitespace character separates the header from the
+        raster of a raw PPM */
+    if (kind == '6') {
+        int c = getc(input);
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            errno = EBADMSG;
+            return NULL;
+        }
+    }
+
+    Ppm_Reader reader = get_memory(arena, sizeof(*reader));
+
+    reader->input = input;
+    reader->raw = (kind == '6');
+    reader->width = width;
+    reader->height = height;
+    reader->denominator = denominator;
+    reader->buffer = NULL;
+    reader->map = NULL;
+    reader->map_size = 0;
+    reader->raster = NULL;
+    reader->arena = arena;
+
+    if (reader->raw) {
+        unsigned bytes = (reader->denominator < 256) ? 1 : 2;
+
+        reader->buffer = get_memory(arena, 
+            3 * bytes * (size_t) reader->width + 1);
+
+        if (bytes == 1 && map_ppm_raster(reader) != 0) {
+            free_ppm_reader(&reader);
+            errno = EBADMSG;
+            return NULL;
+        }
+    }
+
+    return reader;
+}
+
+/* read_ppm_row
+    Purpose: Read the next row of pixels from a PPM.
+
+    Parameters:
+        Ppm_Reader reader - reader to read from
+        struct Pnm_rgb *row - array of reader->width pixels, these values will
+            be set
+
+    Returns: int - 0, or EBADMSG if the input ends early or a sample of a
+        plain PPM is not a number
+
+    Errors: Throws an error if any of the arguments is NULL.
+*/
+int read_ppm_row (Ppm_Reader reader, struct Pnm_rgb *row)
+{
+    assert(reader != NULL);
+    assert(row != NULL || reader->width == 0);
+
+    unsigned i;
+
+    if (!reader->raw) {
+        for (i = 0; i < reader->width; i++) {
+            if (read_ppm_number(reader->input, &row[i].red) != 0 ||
+                read_ppm_number(reader->input, &row[i].green) != 0 ||
+                read_ppm_number(reader->input, &row[i].blue) != 0) {
+                return EBADMSG;
+            }
+        }
+        return 0;
+    }
+
+    unsigned char *b = reader->buffer;
+
+    if (reader->denominator < 256) {
+        size_t n = fread(b, 3, reader->width, reader->input);
+        if (n != reader->width) {
+            return EBADMSG;
+        }
+
+        for (i = 0; i < reader->width; i++) {
+            row[i].red = b[3 * i];
+            row[i].green = b[3 * i + 1];
+            row[i].blue = b[3 * i + 2];
+        }
+    } else {
+        /* two byte samples are stored most significant byte first */
+        size_t n = fread(b, 6, reader->width, reader->input);
+        if (n != reader->width) {
+            return EBADMSG;
+        }
 
-    /* if we set the last bit of a number to zero that ensures that
-        it will be even */
-    unsigned zero_last_bit = ~1; /* all but last bit is 1, used as a mask */
-    unsigned trim_width = image->width & zero_last_bit;
-    unsigned trim_height = image->height & zero_last_bit;
+        for (i = 0; i < reader->width; i++) {
+            row[i].red = b[6 * i] << 8 | b[6 * i + 1];
+            row[i].green = b[6 * i + 2] << 8 | b[6 * i + 3];
+            row[i].blue = b[6 * i + 4] << 8 | b[6 * i + 5];
+        }
+    }
 
-    int size = methods->size(image->pixels);
+    return 0;
+}
 
-    A2Methods_UArray2 trimmed_data = methods->new(trim_width, trim_height, 
-        size);
+/* free_ppm_reader
+    Purpose: Free a Ppm_Reader and unmap its file. Does not close its stream.
 
-    methods->map_default(trimmed_data, copy_pixels, image);
+    Parameters: Ppm_Reader *reader - pointer to reader to free
+*/
+void free_ppm_reader (Ppm_Reader *reader)
+{
+    assert(reader != NULL && *reader != NULL);
 
-    Pnm_ppm trimmed_image = malloc(sizeof(*trimmed_image));
-    assert(trimmed_image != NULL);
+    if ((*reader)->map != NULL) {
+        munmap((*reader)->map, (*reader)->map_size);
+    }
 
-    *trimmed_image = (struct Pnm_ppm) {
-        .width = trim_width,
-        .height = trim_height,
-        .denominator = image->denominator,
-        .pixels = trimmed_data,
-        .methods = methods
+    put_memory((*reader)->arena, (*reader)->buffer);
+    put_memory((*reader)->arena, *reader);
+    *reader = NULL;
+}
+
+/* open_ppm_writer
+    Purpose: Write the header of a raw PPM to a given stream and return a
+        writer for its rows. The header is the same one Pnm_ppmwrite writes.
+
+    Parameters:
+        FILE *output - stream to write to
+        unsigned width - width of the image
+        unsigned height - height of the image
+        unsigned denominator - denominator of the image
+        Arena_T arena - arena to take the writer's memory from, or NULL to
+            use malloc
+
+    Returns: Ppm_Writer - writer ready for the first row of pixels
+
+    Errors: Throws an error if the output is NULL, the denominator is out of
+        range, or if it cannot allocate memory.
+*/
+Ppm_Writer open_ppm_writer (FILE *output, unsigned width, unsigned height,
+    unsigned denominator, Arena_T arena)
+{
+    assert(output != NULL);
+    assert(denominator > 0 && denominator <= MAX_DENOMINATOR);
+
+    Ppm_Writer writer = get_memory(arena, sizeof(*writer));
+
+    size_t stride = (size_t) 3 * ((denominator < 256) ? 1 : 2) * width;
+
+    /* hold as many whole rows as fit in the buffer, and at least one */
+    size_t rows = stride == 0 ? 1 : PPM_WRITE_BUFFER / stride;
+    if (rows == 0) {
+        rows = 1;
+    }
+
+    *writer = (struct Ppm_Writer) {
+        .output = output,
+        .width = width,
+        .height = height,
+        .denominator = denominator,
+        .stride = stride,
+        .used = 0,
+        .capacity = rows * stride,
+        .buffer = get_memory(arena, rows * stride + 1),
+        .arena = arena
     };
 
-    Pnm_ppmfree(&image);
+    fprintf(output, "P6\n%u %u\n%u\n", width, height, denominator);
 
-    return trimmed_image;
+    return writer;
 }
 
-/* write_image
-    Purpose: Write image to stdout
+/* flush_ppm_writer
+    Purpose: Write every row in a Ppm_Writer's buffer to its stream with a
+        single fwrite. Write errors are left in the stream's error
+        indicator for the caller to check.
 
-    Parameters: Pnm_ppm pixmap - image to write
+    Parameters: Ppm_Writer writer - writer to flush
 */
-void write_image (Pnm_ppm pixmap)
+void flush_ppm_writer (Ppm_Writer writer)
 {
-    Pnm_ppmwrite(stdout, pixmap);
+    assert(writer != NULL);
+
+    if (writer->used > 0) {
+        fwrite(writer->buffer, 1, writer->used, writer->output);
+        writer->used = 0;
+    }
 }
 
-/* print_big_endian
-    Purpose: Assuming that pointers are stored in little-endian, output its
-        characters in big-endian order.
+/* next_ppm_rows
+    Purpose: Make room in a Ppm_Writer's buffer for the next rows of the
+        image and return it, so that the caller can fill in the rows' bytes
+        in place instead of copying them in. The rows count as written; their
+        bytes must be filled in before the writer is used again.
 
     Parameters:
-        void *p - data to print
-        unsigned len - length of data pointer
+        Ppm_Writer writer - writer to write with
+        unsigned nrows - number of rows to make room for
+
+    Returns: unsigned char * - space for nrows rows of writer->stride bytes
+
+    Errors: Throws an error if it cannot allocate memory or write the output.
 */
-void print_big_endian (void *p, unsigned len)
+unsigned char *next_ppm_rows (Ppm_Writer writer, unsigned nrows)
 {
-    int i;
-    unsigned char *cp = (unsigned char *) p;
+    assert(writer != NULL);
+
+    size_t size = nrows * writer->stride;
 
-    for (i = len-1; i >= 0; i --) {
-        putchar(*(cp+i));
+    if (writer->used + size > writer->capacity) {
+        flush_ppm_writer(writer);
     }
+
+    if (size > writer->capacity) {
+        put_memory(writer->arena, writer->buffer);
+        writer->capacity = size;
+        writer->buffer = get_memory(writer->arena, size + 1);
+    }
+
+    unsigned char *rows = &writer->buffer[writer->used];
+    writer->used += size;
+
+    return rows;
 }
 
-/* write_codewords 
-    Purpose: Write a sequence of codewords, along with the uncompressed image's
-        width and height, to stdout
+/* write_ppm_bytes
+    Purpose: Write the next row of a PPM whose pixels are already packed the
+        way a raw PPM stores them. The row is copied into the writer's
+        buffer and written out when the buffer fills up.
 
     Parameters:
-        Seq_T codewords - list of codewords
-        unsigned width - width of compressed image
-        unsigned height - height of compressed image
+        Ppm_Writer writer - writer to write with
+        unsigned char *row - the row's bytes, three or six per pixel depending
+            on the writer's denominator
+*/
+void write_ppm_bytes (Ppm_Writer writer, unsigned char *row)
+{
+    assert(writer != NULL);
+    assert(row != NULL || writer->width == 0);
+
+    memcpy(next_ppm_rows(writer, 1), row, writer->stride);
+}
+
+/* free_ppm_writer
+    Purpose: Write out any rows left in a Ppm_Writer's buffer and free it.
+        Does not close its stream.
+
+    Parameters: Ppm_Writer *writer - pointer to writer to free
 */
-void write_codewords (Seq_T codewords, unsigned width, unsigned height)
+void free_ppm_writer (Ppm_Writer *writer)
 {
-    printf("COMP40 Compressed image format 2\n%u %u\n", 
-        COMPRESS_BLOCK_SIZE * width, 
-        COMPRESS_BLOCK_SIZE * height);
+    assert(writer != NULL && *writer != NULL);
+
+    flush_ppm_writer(*writer);
 
-    int i;
-    for (i = 0; i < Seq_length(codewords); i++) {
-        uint64_t *codeword = (uint64_t *) Seq_get(codewords, i);
-        print_big_endian(codeword, CODEWORD_BYTE_SIZE);
+    put_memory((*writer)->arena, (*writer)->buffer);
+    put_memory((*writer)->arena, *writer);
+    *writer = NULL;
+}
+
+/* store_big_endian_scalar
+    Purpose: Store codewords as bytes in big-endian order, one at a time.
+
+    Parameters: See store_big_endian for more info.
+*/
+static void store_big_endian_scalar (uint32_t *codewords, size_t length,
+    unsigned char *bytes)
+{
+    size_t i;
+    for (i = 0; i < length; i++) {
+        bytes[4 * i] = codewords[i] >> 24;
+        bytes[4 * i + 1] = codewords[i] >> 16;
+        bytes[4 * i + 2] = codewords[i] >> 8;
+        bytes[4 * i + 3] = codewords[i];
     }
 }
 
-/* read_codewords
-    Purpose: Read header and list of codewords from given stream
+#ifdef HAVE_AVX2_KERNELS
+
+/* store_big_endian_avx2
+    Purpose: Store codewords as bytes in big-endian order, eight at a time
+        using AVX2. x86 is little-endian, so this reverses the bytes of each
+        codeword with a single shuffle.
+
+    Parameters: See store_big_endian for more info.
+*/
+__attribute__((target("avx2")))
+static void store_big_endian_avx2 (uint32_t *codewords, size_t length,
+    unsigned char *bytes)
+{
+    const __m256i reverse = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    size_t i;
+    for (i = 0; i + AVX2_CODEWORDS <= length; i += AVX2_CODEWORDS) {
+        __m256i words = _mm256_loadu_si256((__m256i *) &codewords[i]);
+        _mm256_storeu_si256((__m256i *) &bytes[4 * i],
+            _mm256_shuffle_epi8(words, reverse));
+    }
+
+    store_big_endian_scalar(&codewords[i], length - i, &bytes[4 * i]);
+}
+
+#endif
+
+/* store_big_endian
+    Purpose: Store codewords as bytes in big-endian order, the way they are
+        written to a compressed file. Uses AVX2 when the processor has it.
 
     Parameters:
-        FILE *codefile - stream to read from
-        unsigned *width - pointer to uncompressed width, this value will be set
-        unsigned *width - pointer to uncompressed height, this value will be
+        uint32_t *codewords - array of length codewords
+        size_t length - number of codewords
+        unsigned char *bytes - array of 4 * length bytes, these values will be
             set
+*/
+static void store_big_endian (uint32_t *codewords, size_t length,
+    unsigned char *bytes)
+{
+#ifdef HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2")) {
+        store_big_endian_avx2(codewords, length, bytes);
+        return;
+    }
+#endif
 
-    Returns: Seq_T - list of codewords
+    store_big_endian_scalar(codewords, length, bytes);
+}
 
-    Errors: Throws an error if any of the arguments is NULL.
+/* load_big_endian_scalar
+    Purpose: Load big-endian codewords from bytes, one at a time.
+
+    Parameters: See load_big_endian for more info.
 */
-Seq_T read_codewords (FILE *codefile, unsigned *width, unsigned *height)
+static void load_big_endian_scalar (unsigned char *bytes, size_t length,
+    uint32_t *codewords)
 {
-    assert(codefile != NULL);
-    assert(width != NULL && height != NULL);
+    size_t i;
+    for (i = 0; i < length; i++) {
+        /* all four bytes are read before the codeword is stored, so bytes
+            and codewords can be the same memory */
+        uint32_t codeword = (uint32_t) bytes[4 * i] << 24 |
+            (uint32_t) bytes[4 * i + 1] << 16 |
+            (uint32_t) bytes[4 * i + 2] << 8 |
+            (uint32_t) bytes[4 * i + 3];
+        codewords[i] = codeword;
+    }
+}
 
-    int read = fscanf(codefile, "COMP40 Compressed image format 2\n%u %u",
-        width, height);
+#ifdef HAVE_AVX2_KERNELS
 
-    assert(read == 2);
+/* load_big_endian_avx2
+    Purpose: Load big-endian codewords from bytes, eight at a time using
+        AVX2. Reversing bytes is its own inverse, so this is the same shuffle
+        as store_big_endian_avx2.
 
-    int c = getc(codefile);
-    assert(c == '\n');
+    Parameters: See load_big_endian for more info.
+*/
+__attribute__((target("avx2")))
+static void load_big_endian_avx2 (unsigned char *bytes, size_t length,
+    uint32_t *codewords)
+{
+    const __m256i reverse = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
 
-    int i;
-    int num_codewords = (*width / COMPRESS_BLOCK_SIZE) * 
-        (*height / COMPRESS_BLOCK_SIZE);
+    size_t i;
+    for (i = 0; i + AVX2_CODEWORDS <= length; i += AVX2_CODEWORDS) {
+        __m256i words = _mm256_loadu_si256((__m256i *) &bytes[4 * i]);
+        _mm256_storeu_si256((__m256i *) &codewords[i],
+            _mm256_shuffle_epi8(words, reverse));
+    }
 
-    Seq_T codewords = Seq_new(0);
+    load_big_endian_scalar(&bytes[4 * i], length - i, &codewords[i]);
+}
 
-    for (i = 0; i < num_codewords; i++) {
-        int j;
-        uint64_t *ptr = malloc(sizeof(*ptr));
-        assert(ptr != NULL);
+#endif
 
-        uint64_t codedata = 0;
+/* load_big_endian
+    Purpose: Load codewords stored as bytes in big-endian order, the way they
+        are read from a compressed file. Uses AVX2 when the processor has it.
 
-        for (j = 0; j < CODEWORD_BYTE_SIZE; j++) {
-            c = getc(codefile);
-            assert(c != EOF);
+    Parameters:
+        unsigned char *bytes - array of 4 * length bytes
+        size_t length - number of codewords
+        uint32_t *codewords - array of length codewords, these values will be
+            set. May be the same memory as bytes.
+*/
+static void load_big_endian (unsigned char *bytes, size_t length,
+    uint32_t *codewords)
+{
+#ifdef HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2")) {
+        load_big_endian_avx2(bytes, length, codewords);
+        return;
+    }
+#endif
+
+    load_big_endian_scalar(bytes, length, codewords);
+}
 
-            /* Shift by 8 because each byte is 8 bits and since codewords are
-                stored in big endian, we read the most significant byte first
-                */
-            codedata = codedata << 8; 
-            codedata |= c;
+/* store_codewords
+    Purpose: Write codewords to a stream as 4 big-endian bytes each.
+        Codewords are byte-swapped into a buffer a chunk at a time, and each
+        chunk is written with a single fwrite.
+
+    Parameters:
+        FILE *output - stream to write to
+        uint32_t *codewords - array of codewords
+        size_t length - number of codewords in the array
+*/
+static void store_codewords (FILE *output, uint32_t *codewords, 
+    size_t length)
+{
+    unsigned char bytes[CODEWORD_CHUNK * CODEWORD_BYTE_SIZE];
+
+    size_t start;
+    for (start = 0; start < length; start += CODEWORD_CHUNK) {
+        size_t count = length - start < CODEWORD_CHUNK ? 
+            length - start : CODEWORD_CHUNK;
+
+        store_big_endian(&codewords[start], count, bytes);
+
+        fwrite(bytes, CODEWORD_BYTE_SIZE, count, output);
+    }
+}
+
+/* tile_length
+    Purpose: get the number of codewords in a tile of a format 3 image. The
+        last tile has whatever rows are left.
+
+    Parameters:
+        unsigned tile - index of the tile
+        unsigned tile_rows - rows in every tile but the last
+        unsigned width - width of the image, in blocks
+        unsigned height - height of the image, in blocks
+
+    Returns: size_t - number of codewords in the tile
+*/
+static size_t tile_length (unsigned tile, unsigned tile_rows, unsigned width,
+    unsigned height)
+{
+    unsigned first = tile * tile_rows;
+    unsigned rows = height - first < tile_rows ? height - first : tile_rows;
+
+    return (size_t) rows * width;
+}
+
+/* can_rewrite
+    Purpose: tell whether bytes written to a stream can be written over
+        later: it can seek, and it is not a file opened for appending, where
+        every write would go to the end.
+
+    Parameters: FILE *output - stream to check
+
+    Returns: int - 1 if it can, and 0 if it cannot
+*/
+static int can_rewrite (FILE *output)
+{
+    long offset = ftell(output);
+    if (offset < 0 || fseek(output, offset, SEEK_SET) != 0) {
+        return 0;
+    }
+
+    /* memory and callback streams have no descriptor */
+    int fd = fileno(output);
+    if (fd >= 0) {
+        int flags = fcntl(fd, F_GETFL);
+        return flags >= 0 && !(flags & O_APPEND);
+    }
+
+    return 1;
+}
+
+/* write_tiled_header
+    Purpose: write the header of a format 3 image, as described in
+        close_codeword_writer.
+
+    Parameters: Codeword_Writer writer - format 3 writer
+*/
+static void write_tiled_header (Codeword_Writer writer)
+{
+    fprintf(writer->output, "COMP40 Compressed image format 3\n%u %u\n%u",
+        COMPRESS_BLOCK_SIZE * writer->width, 
+        COMPRESS_BLOCK_SIZE * writer->height, writer->tile_rows);
+
+    if (writer->predictor != NO_PREDICTOR) {
+        fprintf(writer->output, " %u", writer->predictor);
+    }
+    fputc('\n', writer->output);
+}
+
+/* write_tile_index
+    Purpose: write the tile index of a format 3 image from the sizes of its
+        tiles, as described in close_codeword_writer. Tiles not written yet
+        have a size of 0.
+
+    Parameters: Codeword_Writer writer - format 3 writer
+*/
+static void write_tile_index (Codeword_Writer writer)
+{
+    uint64_t end = 0;
+    unsigned tile;
+    for (tile = 0; tile < writer->ntiles; tile++) {
+        end += writer->tile_sizes[tile];
+
+        unsigned char bytes[TILE_INDEX_BYTE_SIZE];
+        int b;
+        for (b = 0; b < TILE_INDEX_BYTE_SIZE; b++) {
+            bytes[b] = end >> (8 * (TILE_INDEX_BYTE_SIZE - 1 - b));
         }
 
-        *ptr = codedata;
+        fwrite(bytes, 1, TILE_INDEX_BYTE_SIZE, writer->output);
+    }
+}
 
-        Seq_addhi(codewords, ptr);
+/* open_codeword_writer
+    Purpose: Start writing a compressed image. Format 2's header is written
+        right away. So is format 3's, followed by a blank tile index, if the
+        stream can seek; otherwise it is written by close_codeword_writer.
+
+    Parameters:
+        FILE *output - stream to write to
+        unsigned width - width of compressed image, in blocks
+        unsigned height - height of compressed image, in blocks
+        unsigned format - 2 for plain codewords, 3 for entropy coded tiles
+        unsigned predictor - NO_PREDICTOR, or MED_PREDICTOR to code a, Pb
+            and Pr of format 3 tiles as residuals
+        PackingScheme_T pc - where each field is stored in a codeword, used
+            to entropy code format 3
+        Arena_T arena - arena to take the writer's memory and encoded tiles
+            from, or NULL to use malloc
+
+    Returns: Codeword_Writer - writer positioned at the first row
+
+    Errors: Throws an error if output is NULL, if the format is not 2 or 3,
+        if a predictor is asked for in format 2 or if it cannot allocate
+        memory.
+*/
+Codeword_Writer open_codeword_writer (FILE *output, unsigned width, 
+    unsigned height, unsigned format, unsigned predictor, PackingScheme_T pc,
+    Arena_T arena)
+{
+    assert(output != NULL);
+    assert(format == PLAIN_FORMAT || format == TILED_FORMAT);
+    assert(predictor == NO_PREDICTOR || 
+        (predictor == MED_PREDICTOR && format == TILED_FORMAT));
+
+    Codeword_Writer writer = get_memory(arena, sizeof(*writer));
+
+    writer->output = output;
+    writer->width = width;
+    writer->height = height;
+    writer->format = format;
+    writer->predictor = predictor;
+    writer->pc = pc;
+    writer->row = 0;
+    writer->pending = NULL;
+    writer->tiles = NULL;
+    writer->tile_sizes = NULL;
+    writer->index_start = -1;
+    writer->spilled = 0;
+    writer->arena = arena;
+
+    if (format == PLAIN_FORMAT) {
+        writer->tile_rows = 0;
+        writer->ntiles = 0;
+
+        fprintf(output, "COMP40 Compressed image format 2\n%u %u\n", 
+            COMPRESS_BLOCK_SIZE * width, 
+            COMPRESS_BLOCK_SIZE * height);
+        return writer;
+    }
+
+    /* every tile but the last has the same whole number of rows, with
+        about TILE_CODEWORDS codewords in all */
+    writer->tile_rows = width == 0 ? 1 : 
+        (TILE_CODEWORDS + width - 1) / width;
+    writer->ntiles = (height + writer->tile_rows - 1) / writer->tile_rows;
+
+    size_t tiles_size = (writer->ntiles + 1) * sizeof(unsigned char *);
+    size_t sizes_size = (writer->ntiles + 1) * sizeof(size_t);
+
+    writer->pending = get_memory(arena, 
+        ((size_t) writer->tile_rows * width + 1) * sizeof(uint32_t));
+    writer->tiles = memset(get_memory(arena, tiles_size), 0, tiles_size);
+    writer->tile_sizes = memset(get_memory(arena, sizes_size), 0, 
+        sizes_size);
+
+    /* the index is filled in by close_codeword_writer, once every tile's
+        size is known */
+    if (can_rewrite(output)) {
+        write_tiled_header(writer);
+        writer->index_start = ftell(output);
+        write_tile_index(writer);
+    }
+
+    return writer;
+}
+
+/* write_codeword_rows
+    Purpose: Write the next rows of codewords. Any number of rows can be
+        written at once; format 3 encodes each tile as soon as its last row
+        arrives.
+
+    Parameters:
+        Codeword_Writer writer - writer to write with
+        uint32_t *codewords - array of nrows * writer->width codewords,
+            stored row by row
+        unsigned nrows - number of rows to write
+
+    Errors: Throws an error if more rows are written than the image has.
+*/
+void write_codeword_rows (Codeword_Writer writer, uint32_t *codewords, 
+    unsigned nrows)
+{
+    assert(writer != NULL && codewords != NULL);
+    assert(nrows <= writer->height - writer->row);
+
+    if (writer->format == PLAIN_FORMAT) {
+        store_codewords(writer->output, codewords, 
+            (size_t) nrows * writer->width);
+        writer->row += nrows;
+        return;
+    }
+
+    /* rows are gathered into pending until they fill a tile */
+    while (nrows > 0) {
+        unsigned tile = writer->row / writer->tile_rows;
+        unsigned offset = writer->row % writer->tile_rows;
+        unsigned last = writer->height - tile * writer->tile_rows;
+        if (last > writer->tile_rows) {
+            last = writer->tile_rows;
+        }
+
+        unsigned count = last - offset < nrows ? last - offset : nrows;
+
+        memcpy(&writer->pending[(size_t) offset * writer->width], codewords,
+            (size_t) count * writer->width * sizeof(uint32_t));
+
+        codewords += (size_t) count * writer->width;
+        nrows -= count;
+        writer->row += count;
+
+        if (offset + count == last) {
+            write_codeword_tile(writer, tile, writer->pending);
+            flush_codeword_tiles(writer);
+        }
+    }
+}
+
+/* write_codeword_tile
+    Purpose: Encode a whole tile of a format 3 image, in place of writing its
+        rows with write_codeword_rows. Different tiles can be written from
+        several threads at once; the tiles are written out by
+        flush_codeword_tiles. Tiles are predicted on their own, from
+        blocks in the same tile, so they still decode on their own.
+
+    Parameters:
+        Codeword_Writer writer - format 3 writer
+        unsigned tile - index of the tile, from the top
+        uint32_t *codewords - the tile's codewords, stored row by row
+
+    Errors: Throws an error if the writer is not format 3 or the tile does
+        not exist.
+*/
+void write_codeword_tile (Codeword_Writer writer, unsigned tile, 
+    uint32_t *codewords)
+{
+    assert(writer != NULL && codewords != NULL);
+    assert(writer->format == TILED_FORMAT && tile < writer->ntiles);
+    assert(tile >= writer->spilled && writer->tiles[tile] == NULL);
+
+    size_t length = tile_length(tile, writer->tile_rows, writer->width,
+        writer->height);
+
+    /* tiles written out as soon as they can be are freed then, which
+        memory from the arena would not be */
+    Arena_T arena = writer->index_start >= 0 ? NULL : writer->arena;
+
+    if (writer->predictor == NO_PREDICTOR || length == 0) {
+        writer->tiles[tile] = encode_tile(codewords, length, writer->pc,
+            arena, &writer->tile_sizes[tile]);
+        return;
+    }
+
+    /* residuals go in a copy, leaving the caller's codewords alone. It is
+        freed as soon as the tile is encoded, which memory from the arena
+        would not be until the next image, and it cannot be shared since
+        tiles are written from several threads at once. */
+    uint32_t *residuals = malloc(length * sizeof(*residuals));
+    assert(residuals != NULL);
+
+    memcpy(residuals, codewords, length * sizeof(*residuals));
+    predict_codewords(residuals, writer->width, length / writer->width,
+        writer->pc);
+
+    writer->tiles[tile] = encode_tile(residuals, length, writer->pc,
+        arena, &writer->tile_sizes[tile]);
+
+    free(residuals);
+}
+
+/* flush_codeword_tiles
+    Purpose: Write out and free the encoded tiles of a format 3 image that
+        can be, if its stream can seek: every tile whose tiles before it
+        have all been written. Called from one thread, after the tiles
+        given to write_codeword_tile are done.
+
+    Parameters: Codeword_Writer writer - writer to flush
+*/
+void flush_codeword_tiles (Codeword_Writer writer)
+{
+    assert(writer != NULL);
+
+    if (writer->index_start < 0) {
+        return;
+    }
+
+    while (writer->spilled < writer->ntiles && 
+        writer->tiles[writer->spilled] != NULL) {
+        unsigned tile = writer->spilled++;
+
+        fwrite(writer->tiles[tile], 1, writer->tile_sizes[tile], 
+            writer->output);
+        free(writer->tiles[tile]);
+        writer->tiles[tile] = NULL;
+    }
+}
+
+/* close_codeword_writer
+    Purpose: Finish a compressed image and free its writer. Format 3's tile
+        index is written here, along with its header and tiles if they have
+        not been already. Does not close its stream.
+
+        A format 3 image is:
+            - the header "COMP40 Compressed image format 3\n", the image's
+              width and height in pixels, and the rows in a tile, each
+              followed by a newline. With a predictor, the rows in a tile
+              are followed by a space and the predictor instead
+            - for each tile, the offset of its end from the start of the
+              first tile, as 8 big-endian bytes
+            - the tiles, one after the other, as made by encode_tile
+
+    Parameters: Codeword_Writer *writer - pointer to writer to close
+
+    Returns: int - 0, or the errno of a failure to seek back to the tile
+        index and fill it in
+
+    Errors: Throws an error if a row or tile was never written. Write
+        errors are left in the stream's error indicator for the caller to
+        check.
+*/
+int close_codeword_writer (Codeword_Writer *writer)
+{
+    assert(writer != NULL && *writer != NULL);
+
+    Codeword_Writer w = *writer;
+    int error = 0;
+
+    if (w->format == TILED_FORMAT && w->index_start >= 0) {
+        flush_codeword_tiles(w);
+        assert(w->spilled == w->ntiles);
+
+        /* fill in the index, then go back to the end of the tiles */
+        long end = ftell(w->output);
+        if (end < 0 || fseek(w->output, w->index_start, SEEK_SET) != 0) {
+            error = errno != 0 ? errno : EIO;
+        } else {
+            write_tile_index(w);
+            if (fseek(w->output, end, SEEK_SET) != 0) {
+                error = errno != 0 ? errno : EIO;
+            }
+        }
+    } else if (w->format == TILED_FORMAT) {
+        unsigned tile;
+        for (tile = 0; tile < w->ntiles; tile++) {
+            assert(w->tiles[tile] != NULL);
+        }
+
+        write_tiled_header(w);
+        write_tile_index(w);
+
+        for (tile = 0; tile < w->ntiles; tile++) {
+            fwrite(w->tiles[tile], 1, w->tile_sizes[tile], w->output);
+            put_memory(w->arena, w->tiles[tile]);
+        }
+    }
+
+    put_memory(w->arena, w->pending);
+    put_memory(w->arena, w->tiles);
+    put_memory(w->arena, w->tile_sizes);
+    put_memory(w->arena, w);
+
+    *writer = NULL;
+    return error;
+}
+
+/* free_codeword_writer
+    Purpose: Free a Codeword_Writer without finishing its image, as when
+        the input turns out to be malformed partway through. Encoded tiles
+        not written yet are dropped. Does not close its stream.
+
+    Parameters: Codeword_Writer *writer - pointer to writer to free
+*/
+void free_codeword_writer (Codeword_Writer *writer)
+{
+    assert(writer != NULL && *writer != NULL);
+
+    Codeword_Writer w = *writer;
+
+    /* tiles are malloc'd when they are written out as they are made */
+    Arena_T tile_arena = w->index_start >= 0 ? NULL : w->arena;
+
+    unsigned tile;
+    for (tile = 0; tile < w->ntiles; tile++) {
+        if (w->tiles[tile] != NULL) {
+            put_memory(tile_arena, w->tiles[tile]);
+        }
+    }
+
+    put_memory(w->arena, w->pending);
+    put_memory(w->arena, w->tiles);
+    put_memory(w->arena, w->tile_sizes);
+    put_memory(w->arena, w);
+
+    *writer = NULL;
+}
+
+/* map_codeword_file
+    Purpose: Memory map the file a compressed image is being read from and
+        point reader->payload at the stream's position, which is the first
+        codeword of format 2 or the first tile of format 3. Leaves the
+        reader unchanged if the input is not a regular file or cannot be
+        mapped. The stream itself is not moved.
+
+    Parameters:
+        Codeword_Reader reader - reader positioned at the first codeword or
+            tile
+        uint64_t payload_size - bytes of codewords or tiles the header and
+            tile index say follow
+
+    Returns: int - 0, or EBADMSG if the file is too short for the payload
+*/
+static int map_codeword_file (Codeword_Reader reader, uint64_t payload_size)
+{
+    struct stat info;
+    int fd = fileno(reader->input);
+    long offset = ftell(reader->input);
+
+    if (offset < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        return 0;
+    }
+
+    /* checking the size once here is what lets rows and tiles be loaded
+        straight from the mapping */
+    if (info.st_size < offset || 
+        (uint64_t) (info.st_size - offset) < payload_size) {
+        return EBADMSG;
+    }
+
+    if (info.st_size == 0) {
+        return 0;
+    }
+
+    unsigned char *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE,
+        fd, 0);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    reader->map = map;
+    reader->map_size = info.st_size;
+    reader->payload = &map[offset];
+
+    return 0;
+}
+
+/* seek_tiles
+    Purpose: Move the stream of a format 3 reader that is not mapped to a
+        given offset in its tiles. Streams that can seek are moved there
+        directly; others, like pipes, can only move forward, by reading and
+        dropping the bytes in between.
+
+    Parameters:
+        Codeword_Reader reader - format 3 reader whose file is not mapped
+        uint64_t offset - offset from the start of the first tile
+
+    Returns: int - 0, EBADMSG if the stream ends before offset, or the
+        errno of a failure to seek
+
+    Errors: Throws an error if the stream cannot seek and offset is before
+        where it is.
+*/
+static int seek_tiles (Codeword_Reader reader, uint64_t offset)
+{
+    if (reader->tiles_start >= 0) {
+        if (offset > (uint64_t) (LONG_MAX - reader->tiles_start)) {
+            return EBADMSG;
+        }
+
+        if (fseek(reader->input, reader->tiles_start + (long) offset,
+            SEEK_SET) != 0) {
+            return errno != 0 ? errno : EIO;
+        }
+
+        reader->position = offset;
+        return 0;
+    }
+
+    assert(offset >= reader->position);
+
+    unsigned char bytes[CODEWORD_CHUNK];
+
+    while (reader->position < offset) {
+        size_t count = offset - reader->position < CODEWORD_CHUNK ?
+            offset - reader->position : CODEWORD_CHUNK;
+
+        size_t got = fread(bytes, 1, count, reader->input);
+        if (got != count) {
+            return EBADMSG;
+        }
+
+        reader->position += count;
+    }
+
+    return 0;
+}
+
+/* reject_codeword_reader
+    Purpose: Free a Codeword_Reader that open_codeword_reader could not
+        finish opening, and say why.
+
+    Parameters:
+        Codeword_Reader reader - reader to free
+        int error - errno value to report
+
+    Returns: Codeword_Reader - NULL, with errno set to error
+*/
+static Codeword_Reader reject_codeword_reader (Codeword_Reader reader, 
+    int error)
+{
+    free_codeword_reader(&reader);
+
+    errno = error;
+    return NULL;
+}
+
+/* open_codeword_reader
+    Purpose: Read the header of a compressed image of either format from
+        given stream, and for format 3 its tile index. Tiles are read when
+        they are needed.
+
+    Parameters:
+        FILE *input - stream to read from
+        PackingScheme_T pc - where each field is stored in a codeword, used
+            to decode format 3
+        Arena_T arena - arena to take the reader's memory from, or NULL to
+            use malloc
+
+    Returns: Codeword_Reader - reader positioned at the first row, or NULL
+        with errno set to EINVAL if the input is not a compressed image of
+        a format we know, or to EBADMSG if the header or tile index is
+        malformed or longer than the file or if the stream ends early
+
+    Errors: Throws an error if input is NULL or if it cannot allocate
+        memory.
+*/
+Codeword_Reader open_codeword_reader (FILE *input, PackingScheme_T pc,
+    Arena_T arena)
+{
+    assert(input != NULL);
+
+    unsigned format, width, height;
+    int read = fscanf(input, "COMP40 Compressed image format %u\n%u %u",
+        &format, &width, &height);
+
+    if (read < 1 || (format != PLAIN_FORMAT && format != TILED_FORMAT)) {
+        errno = EINVAL;
+        return NULL;
+    } else if (read != 3) {
+        errno = EBADMSG;
+        return NULL;
+    }
+
+    Codeword_Reader reader = get_memory(arena, sizeof(*reader));
+
+    reader->input = input;
+    reader->width = width / COMPRESS_BLOCK_SIZE;
+    reader->height = height / COMPRESS_BLOCK_SIZE;
+    reader->format = format;
+    reader->predictor = NO_PREDICTOR;
+    reader->pc = pc;
+    reader->row = 0;
+    reader->tile_rows = 0;
+    reader->ntiles = 0;
+    reader->tile_ends = NULL;
+    reader->cache = NULL;
+    reader->cached = 0;
+    reader->map = NULL;
+    reader->map_size = 0;
+    reader->payload = NULL;
+    reader->tiles_start = -1;
+    reader->position = 0;
+    reader->loaded = NULL;
+    reader->loaded_size = 0;
+    reader->loaded_start = 0;
+    reader->first_loaded = 0;
+    reader->nloaded = 0;
+    reader->arena = arena;
+
+    int c;
+
+    if (format == TILED_FORMAT) {
+        /* tiles are never longer than the writer makes them, which keeps
+            the memory a decoded tile takes O(width) */
+        read = fscanf(input, "%u", &reader->tile_rows);
+        if (read != 1 || reader->tile_rows == 0 || 
+            (uint64_t) (reader->tile_rows - 1) * reader->width >= 
+            TILE_CODEWORDS) {
+            return reject_codeword_reader(reader, EBADMSG);
+        }
+
+        /* files without a predictor have nothing after the rows */
+        c = getc(input);
+        if (c == ' ') {
+            read = fscanf(input, "%u", &reader->predictor);
+            if (read != 1 || reader->predictor != MED_PREDICTOR) {
+                return reject_codeword_reader(reader, EBADMSG);
+            }
+        } else {
+            ungetc(c, input);
+        }
+    }
+
+    c = getc(input);
+    if (c != '\n') {
+        return reject_codeword_reader(reader, EBADMSG);
+    }
+
+    if (format == PLAIN_FORMAT) {
+        if (map_codeword_file(reader, (uint64_t) CODEWORD_BYTE_SIZE * 
+            reader->width * reader->height) != 0) {
+            return reject_codeword_reader(reader, EBADMSG);
+        }
+        return reader;
+    }
+
+    /* a tile never has more rows than the image, which also keeps the sum
+        below from overflowing */
+    if (reader->tile_rows > reader->height && reader->height > 0) {
+        reader->tile_rows = reader->height;
+    }
+
+    reader->ntiles = (reader->height + reader->tile_rows - 1) / 
+        reader->tile_rows;
+    reader->cached = reader->ntiles;
+
+    /* the index of a regular file has to fit in what is left of it */
+    struct stat info;
+    long offset = ftell(input);
+    if (offset >= 0 && fstat(fileno(input), &info) == 0 && 
+        S_ISREG(info.st_mode) && (info.st_size < offset || 
+        (uint64_t) (info.st_size - offset) / TILE_INDEX_BYTE_SIZE < 
+        reader->ntiles)) {
+        return reject_codeword_reader(reader, EBADMSG);
+    }
+
+    reader->tile_ends = get_memory(arena, 
+        (reader->ntiles + 1) * sizeof(uint64_t));
+
+    uint64_t previous = 0;
+    unsigned tile;
+    for (tile = 0; tile < reader->ntiles; tile++) {
+        unsigned char bytes[TILE_INDEX_BYTE_SIZE];
+        size_t got = fread(bytes, 1, TILE_INDEX_BYTE_SIZE, input);
+        if (got != TILE_INDEX_BYTE_SIZE) {
+            return reject_codeword_reader(reader, EBADMSG);
+        }
+
+        uint64_t end = 0;
+        int b;
+        for (b = 0; b < TILE_INDEX_BYTE_SIZE; b++) {
+            end = (end << 8) | bytes[b];
+        }
+
+        /* no tile is longer than encode_tile makes one, so a bad index
+            cannot make load_codeword_tiles allocate more than that */
+        size_t length = tile_length(tile, reader->tile_rows, reader->width,
+            reader->height);
+        if (end < previous || end - previous > max_tile_size(length, pc)) {
+            return reject_codeword_reader(reader, EBADMSG);
+        }
+
+        reader->tile_ends[tile] = previous = end;
+    }
+
+    if (previous >= SIZE_MAX || map_codeword_file(reader, previous) != 0) {
+        return reject_codeword_reader(reader, EBADMSG);
+    }
+
+    if (reader->payload == NULL) {
+        reader->tiles_start = ftell(input);
+    }
+
+    return reader;
+}
+
+/* read_codeword_rows
+    Purpose: Read the next rows of codewords. Format 2 rows are byte-swapped
+        straight out of the file's mapping, or read with one fread and then
+        byte-swapped in place when the file is not mapped; format 3 rows are
+        copied out of their tiles, each of which is decoded once.
+
+    Parameters:
+        Codeword_Reader reader - reader to read from
+        uint32_t *codewords - array of nrows * reader->width codewords, these
+            values will be set
+        unsigned nrows - number of rows to read
+
+    Returns: int - 0, or the error from read_codeword_tile, or EBADMSG if
+        the stream ends early
+
+    Errors: Throws an error if more rows are read than the image has.
+*/
+int read_codeword_rows (Codeword_Reader reader, uint32_t *codewords, 
+    unsigned nrows)
+{
+    assert(reader != NULL && codewords != NULL);
+    assert(nrows <= reader->height - reader->row);
+
+    if (reader->format == PLAIN_FORMAT) {
+        size_t length = (size_t) nrows * reader->width;
+        unsigned char *bytes = (unsigned char *) codewords;
+
+        if (reader->payload != NULL) {
+            bytes = &reader->payload[(size_t) CODEWORD_BYTE_SIZE * 
+                reader->row * reader->width];
+        } else {
+            size_t read = fread(codewords, CODEWORD_BYTE_SIZE, length, 
+                reader->input);
+            if (read != length) {
+                return EBADMSG;
+            }
+        }
+
+        load_big_endian(bytes, length, codewords);
+        reader->row += nrows;
+        return 0;
+    }
+
+    if (reader->cache == NULL) {
+        reader->cache = get_memory(reader->arena, 
+            ((size_t) reader->tile_rows * reader->width + 1) * 
+            sizeof(uint32_t));
+    }
+
+    while (nrows > 0) {
+        unsigned tile = reader->row / reader->tile_rows;
+        unsigned offset = reader->row % reader->tile_rows;
+        unsigned last = reader->height - tile * reader->tile_rows;
+        if (last > reader->tile_rows) {
+            last = reader->tile_rows;
+        }
+
+        if (reader->cached != tile) {
+            int error = read_codeword_tile(reader, tile, reader->cache);
+            if (error != 0) {
+                return error;
+            }
+            reader->cached = tile;
+        }
+
+        unsigned count = last - offset < nrows ? last - offset : nrows;
+
+        memcpy(codewords, &reader->cache[(size_t) offset * reader->width],
+            (size_t) count * reader->width * sizeof(uint32_t));
+
+        codewords += (size_t) count * reader->width;
+        nrows -= count;
+        reader->row += count;
+    }
+
+    return 0;
+}
+
+/* read_codeword_tile
+    Purpose: Decode one tile of a format 3 image, without reading or
+        decoding any other. Different tiles can be read from several threads
+        at once, as long as read_codeword_rows is not used meanwhile and,
+        unless the file is mapped, the tiles were loaded with
+        load_codeword_tiles first.
+
+    Parameters:
+        Codeword_Reader reader - format 3 reader
+        unsigned tile - index of the tile, from the top
+        uint32_t *codewords - array of reader->tile_rows * reader->width
+            codewords, these values will be set; the last tile may have
+            fewer rows
+
+    Returns: int - 0, EBADMSG if the tile is malformed, or the error from
+        load_codeword_tiles if it has to be read first
+
+    Errors: Throws an error if the reader is not format 3 or the tile does
+        not exist.
+*/
+int read_codeword_tile (Codeword_Reader reader, unsigned tile, 
+    uint32_t *codewords)
+{
+    assert(reader != NULL && codewords != NULL);
+    assert(reader->format == TILED_FORMAT && tile < reader->ntiles);
+
+    uint64_t start = tile == 0 ? 0 : reader->tile_ends[tile - 1];
+    size_t length = tile_length(tile, reader->tile_rows, reader->width,
+        reader->height);
+
+    unsigned char *bytes;
+
+    if (reader->payload != NULL) {
+        bytes = &reader->payload[start];
+    } else {
+        if (tile - reader->first_loaded >= reader->nloaded) {
+            int error = load_codeword_tiles(reader, tile, 1);
+            if (error != 0) {
+                return error;
+            }
+        }
+
+        bytes = &reader->loaded[start - reader->loaded_start];
+    }
+
+    if (decode_tile(bytes, reader->tile_ends[tile] - start, reader->pc, 
+        codewords, length) != 0) {
+        return EBADMSG;
+    }
+
+    if (reader->predictor == MED_PREDICTOR && length > 0) {
+        unpredict_codewords(codewords, reader->width, 
+            length / reader->width, reader->pc);
+    }
+
+    return 0;
+}
+
+/* load_codeword_tiles
+    Purpose: Read a run of format 3 tiles into memory, still entropy coded,
+        so that read_codeword_tile can decode them from several threads.
+        Tiles of a mapped file are already in memory, so nothing is read.
+        Otherwise the tiles replace the ones loaded before, and the stream
+        seeks to them or, if it cannot seek, reads past the tiles before
+        them; such streams can only load tiles in order.
+
+    Parameters:
+        Codeword_Reader reader - format 3 reader
+        unsigned first - index of the first tile to load
+        unsigned count - number of tiles to load
+
+    Returns: int - 0, EBADMSG if the stream ends early, or the errno of a
+        failure to seek
+
+    Errors: Throws an error if the reader is not format 3, a tile does not
+        exist or if it cannot allocate memory.
+*/
+int load_codeword_tiles (Codeword_Reader reader, unsigned first, 
+    unsigned count)
+{
+    assert(reader != NULL && reader->format == TILED_FORMAT);
+    assert(first <= reader->ntiles && count <= reader->ntiles - first);
+
+    if (reader->payload != NULL || count == 0) {
+        return 0;
+    }
+
+    uint64_t start = first == 0 ? 0 : reader->tile_ends[first - 1];
+    uint64_t end = reader->tile_ends[first + count - 1];
+    size_t size = end - start;
+
+    if (start != reader->position) {
+        int error = seek_tiles(reader, start);
+        if (error != 0) {
+            return error;
+        }
+    }
+
+    if (size + 1 > reader->loaded_size) {
+        put_memory(reader->arena, reader->loaded);
+        reader->loaded = get_memory(reader->arena, size + 1);
+        reader->loaded_size = size + 1;
+    }
+
+    size_t got = fread(reader->loaded, 1, size, reader->input);
+    if (got != size) {
+        return EBADMSG;
+    }
+
+    reader->position = end;
+    reader->loaded_start = start;
+    reader->first_loaded = first;
+    reader->nloaded = count;
+
+    return 0;
+}
+
+/* free_codeword_reader
+    Purpose: Free a Codeword_Reader and unmap its file. Does not close its
+        stream.
+
+    Parameters: Codeword_Reader *reader - pointer to reader to free
+*/
+void free_codeword_reader (Codeword_Reader *reader)
+{
+    assert(reader != NULL && *reader != NULL);
+
+    if ((*reader)->map != NULL) {
+        munmap((*reader)->map, (*reader)->map_size);
+    }
+
+    put_memory((*reader)->arena, (*reader)->tile_ends);
+    put_memory((*reader)->arena, (*reader)->loaded);
+    put_memory((*reader)->arena, (*reader)->cache);
+    put_memory((*reader)->arena, *reader);
+
+    *reader = NULL;
+}
+
+/* read_codewords_at
+    Purpose: Read a run of codewords from anywhere in a compressed file
+        without reading the codewords before it. Every codeword takes the
+        same 4 bytes, so its offset is known, and pread fetches just the
+        bytes that are needed without moving the stream.
+
+    Parameters:
+        FILE *codefile - seekable stream to read from
+        long start - offset of the first codeword in the file, which is
+            ftell(codefile) right after open_codeword_reader
+        size_t index - index of the first codeword to read, counting row
+            by row from the top-left block
+        uint32_t *codewords - array of length codewords, these values will
+            be set
+        unsigned length - number of codewords to read
+
+    Returns: int - 0, EBADMSG if the file ends early, or EIO or the errno
+        of a failure to read it
+*/
+int read_codewords_at (FILE *codefile, long start, size_t index, 
+    uint32_t *codewords, unsigned length)
+{
+    assert(codefile != NULL && codewords != NULL && start >= 0);
+
+    int fd = fileno(codefile);
+    unsigned char *bytes = (unsigned char *) codewords;
+    size_t size = (size_t) length * CODEWORD_BYTE_SIZE;
+    off_t offset = start + (off_t) index * CODEWORD_BYTE_SIZE;
+
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, &bytes[done], size - done, offset + done);
+        if (n < 0) {
+            return errno != 0 ? errno : EIO;
+        } else if (n == 0) {
+            return EBADMSG;
+        }
+        done += n;
     }
 
-    return codewords;
+    load_big_endian(bytes, length, codewords);
+    return 0;
 }
\ No newline at end of file
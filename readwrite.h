@@ -12,57 +12,416 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <seq.h>
 #include <assert.h>
 #include <pnm.h>
 
-/* read_image
-        Purpose: Read in a Pnm_ppm from a given filename and trim its width and
-                height so that they're even.
+#include "codewords.h"
+#include "arena.h"
+#include "options.h"
+
+/* Ppm_Reader reads a PPM one scanline at a time, so that only a single row
+        of the image is ever held in memory. If the PPM is a raw P6 regular
+        file with 8-bit samples, the file is also memory mapped and raster
+        points at its first pixel, so rows can be used without reading or
+        copying them. */
+typedef struct Ppm_Reader {
+        FILE *input;
+        unsigned width, height, denominator;
+        int raw;                /* nonzero for P6, zero for P3 */
+        unsigned char *buffer;  /* holds one raw P6 scanline */
+        unsigned char *map;     /* whole file if it is mapped, else NULL */
+        size_t map_size;
+        unsigned char *raster;  /* packed 8-bit pixels in map, or NULL */
+        Arena_T arena;          /* where its memory is from, or NULL */
+} *Ppm_Reader;
+
+/* Ppm_Writer writes a raw PPM a scanline at a time. Rows are packed into
+        a large buffer that is written out with one fwrite when it fills up,
+        so only that buffer is ever held in memory */
+typedef struct Ppm_Writer {
+        FILE *output;
+        unsigned width, height, denominator;
+        size_t stride;          /* bytes in one raw scanline */
+        size_t used, capacity;  /* bytes of buffer in use and allocated */
+        unsigned char *buffer;  /* whole raw scanlines not yet written */
+        Arena_T arena;          /* where its memory is from, or NULL */
+} *Ppm_Writer;
+
+/* Codeword_Writer writes a compressed image a batch of codeword rows at a
+        time. Format 2 stores every codeword as 4 big-endian bytes and is
+        written as rows arrive. Format 3 entropy codes tiles of tile_rows
+        rows each, optionally as residuals from a predictor. The tile index
+        comes before the tiles, so if the stream can seek, the header and
+        a blank index are written first, tiles are written out as soon as
+        the ones before them have been, and the index is filled in when the
+        writer is closed. Otherwise encoded tiles are held in memory and
+        the file is written when the writer is closed. */
+typedef struct Codeword_Writer {
+        FILE *output;
+        unsigned width, height; /* size of the image, in blocks */
+        unsigned format;
+        unsigned predictor;     /* NO_PREDICTOR, or MED_PREDICTOR (format 3) */
+        PackingScheme_T pc;
+        unsigned tile_rows, ntiles;
+        unsigned row;           /* rows written so far */
+        uint32_t *pending;      /* rows of the tile being filled */
+        unsigned char **tiles;  /* encoded tiles, NULL until written */
+        size_t *tile_sizes;
+        long index_start;       /* offset of the index if tiles are written
+                                   as they are made, or -1 */
+        unsigned spilled;       /* tiles already written to output */
+        Arena_T arena;          /* where its memory is from, or NULL */
+} *Codeword_Writer;
+
+/* Codeword_Reader reads a compressed image of either format, in order with
+        read_codeword_rows or, in format 3, a tile at a time in any order
+        with read_codeword_tile. If the image is a regular file, the file
+        is memory mapped and its length checked once against the header and
+        tile index, so rows and tiles are loaded from the mapping with no
+        fread and only the tiles that are used are ever touched. Other
+        streams read format 3 tiles when they are needed, a run at a time
+        with load_codeword_tiles, so memory use never depends on the
+        image's height. */
+typedef struct Codeword_Reader {
+        FILE *input;
+        unsigned width, height; /* size of the image, in blocks */
+        unsigned format;
+        unsigned predictor;     /* predictor recorded in the header */
+        PackingScheme_T pc;
+        unsigned tile_rows, ntiles;
+        unsigned row;           /* next row read_codeword_rows returns */
+        uint64_t *tile_ends;    /* end of each tile, from start of tiles */
+        uint32_t *cache;        /* decoded tile read_codeword_rows is in */
+        unsigned cached;        /* index of that tile, or ntiles if none */
+        unsigned char *map;     /* whole file if it is mapped, else NULL */
+        size_t map_size;
+        unsigned char *payload; /* codewords or tiles in map, or NULL */
+        long tiles_start;       /* offset of the tiles if it can seek, or -1 */
+        uint64_t position;      /* offset in the tiles the stream is at */
+        unsigned char *loaded;  /* tiles from load_codeword_tiles */
+        size_t loaded_size;     /* bytes allocated for loaded */
+        uint64_t loaded_start;  /* offset in the tiles of the first one */
+        unsigned first_loaded, nloaded;
+        Arena_T arena;          /* where its memory is from, or NULL */
+} *Codeword_Reader;
+
+/* open_ppm_reader
+        Purpose: Read the header of a PPM from a given stream and return a
+                reader for its rows.
 
         Parameters:
                 FILE *input - stream to read from
-                A2Methods methods - methods to operate on copy over pixels to
-                trimmed image
+                Arena_T arena - arena to take the reader's memory from, or
+                        NULL to use malloc
+
+        Returns: Ppm_Reader - reader positioned at the first row of pixels,
+                or NULL with errno set to EINVAL if the input is not a PPM,
+                or to EBADMSG if its header is malformed or a file is too
+                short for its pixels
+
+        Errors: Throws an error if the input is NULL or if it cannot
+                allocate memory.
+*/
+Ppm_Reader open_ppm_reader (FILE *input, Arena_T arena);
+
+/* read_ppm_row
+        Purpose: Read the next row of pixels from a PPM.
+
+        Parameters:
+                Ppm_Reader reader - reader to read from
+                struct Pnm_rgb *row - array of reader->width pixels, these
+                        values will be set
 
-        Returns: Pnm_ppm - trimmed image
+        Returns: int - 0, or EBADMSG if the input ends early or a sample of
+                a plain PPM is not a number
 
-        Errors: Throws an error if the input is NULL or cannot allocate memory.
+        Errors: Throws an error if any of the arguments is NULL.
 */
-Pnm_ppm read_image (FILE *input, A2Methods_T methods);
+int read_ppm_row (Ppm_Reader reader, struct Pnm_rgb *row);
 
-/* write_image
-        Purpose: Write image to stdout
+/* free_ppm_reader
+        Purpose: Free a Ppm_Reader and unmap its file. Does not close its
+                stream.
 
-        Parameters: Pnm_ppm pixmap - image to write
+        Parameters: Ppm_Reader *reader - pointer to reader to free
 */
-void write_image (Pnm_ppm pixmap);
+void free_ppm_reader (Ppm_Reader *reader);
 
-/* write_codewords 
-        Purpose: Write a sequence of codewords, along with the uncompressed
-                image's width and height, to stdout
+/* open_ppm_writer
+        Purpose: Write the header of a raw PPM to a given stream and return
+                a writer for its rows.
 
         Parameters:
-                Seq_T codewords - list of codewords
-                unsigned width - width of compressed image
-                unsigned height - height of compressed image
+                FILE *output - stream to write to
+                unsigned width - width of the image
+                unsigned height - height of the image
+                unsigned denominator - denominator of the image
+                Arena_T arena - arena to take the writer's memory from, or
+                        NULL to use malloc
+
+        Returns: Ppm_Writer - writer ready for the first row of pixels
+
+        Errors: Throws an error if the output is NULL, the denominator is
+                out of range, or if it cannot allocate memory.
 */
-void write_codewords(Seq_T codewords, unsigned width, unsigned height);
+Ppm_Writer open_ppm_writer (FILE *output, unsigned width, unsigned height,
+        unsigned denominator, Arena_T arena);
 
-/* read_codewords
-        Purpose: Read header and list of codewords from given stream
+/* next_ppm_rows
+        Purpose: Make room in a Ppm_Writer's buffer for the next rows of the
+                image and return it, so that the caller can fill in the
+                rows' bytes in place instead of copying them in. The rows
+                count as written; their bytes must be filled in before the
+                writer is used again.
 
         Parameters:
-                FILE *codefile - stream to read from
-                unsigned *width - pointer to uncompressed width, this value 
-                        will be set
-                unsigned *width - pointer to uncompressed height, this value 
-                        will be set
+                Ppm_Writer writer - writer to write with
+                unsigned nrows - number of rows to make room for
 
-        Returns: Seq_T - list of codewords
+        Returns: unsigned char * - space for nrows rows of writer->stride
+                bytes
 
-        Errors: Throws an error if any of the arguments is NULL.
+        Errors: Throws an error if it cannot allocate memory or write the
+                output.
+*/
+unsigned char *next_ppm_rows (Ppm_Writer writer, unsigned nrows);
+
+/* flush_ppm_writer
+        Purpose: Write every row in a Ppm_Writer's buffer to its stream with
+                a single fwrite. Write errors are left in the stream's
+                error indicator for the caller to check.
+
+        Parameters: Ppm_Writer writer - writer to flush
+*/
+void flush_ppm_writer (Ppm_Writer writer);
+
+/* write_ppm_bytes
+        Purpose: Write the next row of a PPM whose pixels are already packed
+                the way a raw PPM stores them.
+
+        Parameters:
+                Ppm_Writer writer - writer to write with
+                unsigned char *row - the row's bytes, three or six per pixel
+                        depending on the writer's denominator
+*/
+void write_ppm_bytes (Ppm_Writer writer, unsigned char *row);
+
+/* free_ppm_writer
+        Purpose: Write out any rows left in a Ppm_Writer's buffer and free
+                it. Does not close its stream.
+
+        Parameters: Ppm_Writer *writer - pointer to writer to free
+*/
+void free_ppm_writer (Ppm_Writer *writer);
+
+/* open_codeword_writer
+        Purpose: Start writing a compressed image. Format 2's header is
+                written right away. So is format 3's if the stream can
+                seek, and otherwise it is written by close_codeword_writer.
+
+        Parameters:
+                FILE *output - stream to write to
+                unsigned width - width of compressed image, in blocks
+                unsigned height - height of compressed image, in blocks
+                unsigned format - 2 for plain codewords, 3 for entropy
+                        coded tiles
+                unsigned predictor - NO_PREDICTOR, or MED_PREDICTOR to code
+                        a, Pb and Pr of format 3 tiles as residuals
+                PackingScheme_T pc - where each field is stored in a
+                        codeword, used to entropy code format 3
+                Arena_T arena - arena to take the writer's memory and
+                        encoded tiles from, or NULL to use malloc
+
+        Returns: Codeword_Writer - writer positioned at the first row
+
+        Errors: Throws an error if output is NULL, if the format is not 2 or
+                3, if a predictor is asked for in format 2 or if it cannot
+                allocate memory.
+*/
+Codeword_Writer open_codeword_writer (FILE *output, unsigned width, 
+        unsigned height, unsigned format, unsigned predictor, 
+        PackingScheme_T pc, Arena_T arena);
+
+/* write_codeword_rows
+        Purpose: Write the next rows of codewords. Any number of rows can be
+                written at once; format 3 encodes each tile as soon as its
+                last row arrives.
+
+        Parameters:
+                Codeword_Writer writer - writer to write with
+                uint32_t *codewords - array of nrows * writer->width
+                        codewords, stored row by row
+                unsigned nrows - number of rows to write
+
+        Errors: Throws an error if more rows are written than the image
+                has.
+*/
+void write_codeword_rows (Codeword_Writer writer, uint32_t *codewords, 
+        unsigned nrows);
+
+/* write_codeword_tile
+        Purpose: Encode a whole tile of a format 3 image, in place of
+                writing its rows with write_codeword_rows. Different tiles
+                can be written from several threads at once; the tiles are
+                written out by flush_codeword_tiles.
+
+        Parameters:
+                Codeword_Writer writer - format 3 writer
+                unsigned tile - index of the tile, from the top
+                uint32_t *codewords - the tile's codewords, stored row by row
+
+        Errors: Throws an error if the writer is not format 3 or the tile
+                does not exist.
+*/
+void write_codeword_tile (Codeword_Writer writer, unsigned tile, 
+        uint32_t *codewords);
+
+/* flush_codeword_tiles
+        Purpose: Write out and free the encoded tiles of a format 3 image
+                that can be, if its stream can seek: every tile whose tiles
+                before it have all been written. Call it from one thread,
+                after the tiles given to write_codeword_tile are done.
+
+        Parameters: Codeword_Writer writer - writer to flush
+*/
+void flush_codeword_tiles (Codeword_Writer writer);
+
+/* close_codeword_writer
+        Purpose: Finish a compressed image and free its writer. Format 3's
+                tile index is written here, along with its header and tiles
+                if they have not been already. Does not close its stream;
+                as with the other writers, write errors are left in its
+                error indicator for the caller to check.
+
+        Parameters: Codeword_Writer *writer - pointer to writer to close
+
+        Returns: int - 0, or the errno of a failure to seek back to the
+                tile index and fill it in
+
+        Errors: Throws an error if a row or tile was never written.
+*/
+int close_codeword_writer (Codeword_Writer *writer);
+
+/* free_codeword_writer
+        Purpose: Free a Codeword_Writer without finishing its image, as when
+                the input turns out to be malformed partway through. Encoded
+                tiles not written yet are dropped. Does not close its
+                stream.
+
+        Parameters: Codeword_Writer *writer - pointer to writer to free
+*/
+void free_codeword_writer (Codeword_Writer *writer);
+
+/* open_codeword_reader
+        Purpose: Read the header of a compressed image of either format from
+                given stream, and for format 3 its tile index. Tiles are
+                read when they are needed.
+
+        Parameters:
+                FILE *input - stream to read from
+                PackingScheme_T pc - where each field is stored in a
+                        codeword, used to decode format 3
+                Arena_T arena - arena to take the reader's memory from, or
+                        NULL to use malloc
+
+        Returns: Codeword_Reader - reader positioned at the first row, or
+                NULL with errno set to EINVAL if the input is not a
+                compressed image of a format we know, or to EBADMSG if the
+                header or tile index is malformed or longer than the file or
+                if the stream ends early
+
+        Errors: Throws an error if input is NULL or if it cannot allocate
+                memory.
+*/
+Codeword_Reader open_codeword_reader (FILE *input, PackingScheme_T pc,
+        Arena_T arena);
+
+/* read_codeword_rows
+        Purpose: Read the next rows of codewords.
+
+        Parameters:
+                Codeword_Reader reader - reader to read from
+                uint32_t *codewords - array of nrows * reader->width
+                        codewords, these values will be set
+                unsigned nrows - number of rows to read
+
+        Returns: int - 0, or the error from read_codeword_tile, or EBADMSG
+                if the stream ends early
+
+        Errors: Throws an error if more rows are read than the image has.
+*/
+int read_codeword_rows (Codeword_Reader reader, uint32_t *codewords, 
+        unsigned nrows);
+
+/* read_codeword_tile
+        Purpose: Decode one tile of a format 3 image, without reading or
+                decoding any other. Different tiles can be read from
+                several threads at once, as long as read_codeword_rows is
+                not used meanwhile and, unless the file is mapped, the tiles
+                were loaded with load_codeword_tiles first.
+
+        Parameters:
+                Codeword_Reader reader - format 3 reader
+                unsigned tile - index of the tile, from the top
+                uint32_t *codewords - array of reader->tile_rows *
+                        reader->width codewords, these values will be set;
+                        the last tile may have fewer rows
+
+        Returns: int - 0, EBADMSG if the tile is malformed, or the error
+                from load_codeword_tiles if it has to be read first
+
+        Errors: Throws an error if the reader is not format 3 or the tile
+                does not exist.
+*/
+int read_codeword_tile (Codeword_Reader reader, unsigned tile, 
+        uint32_t *codewords);
+
+/* load_codeword_tiles
+        Purpose: Read a run of format 3 tiles into memory, still entropy
+                coded, so that read_codeword_tile can decode them from
+                several threads. Nothing is read if the file is mapped.
+                Streams that cannot seek can only load tiles in order.
+
+        Parameters:
+                Codeword_Reader reader - format 3 reader
+                unsigned first - index of the first tile to load
+                unsigned count - number of tiles to load
+
+        Returns: int - 0, EBADMSG if the stream ends early, or the errno of
+                a failure to seek
+
+        Errors: Throws an error if the reader is not format 3, a tile does
+                not exist or if it cannot allocate memory.
+*/
+int load_codeword_tiles (Codeword_Reader reader, unsigned first, 
+        unsigned count);
+
+/* free_codeword_reader
+        Purpose: Free a Codeword_Reader. Does not close its stream.
+
+        Parameters: Codeword_Reader *reader - pointer to reader to free
+*/
+void free_codeword_reader (Codeword_Reader *reader);
+
+/* read_codewords_at
+        Purpose: Read a run of codewords from anywhere in a format 2
+                compressed file without reading the codewords before it,
+                using pread.
+
+        Parameters:
+                FILE *codefile - seekable stream to read from
+                long start - offset of the first codeword in the file, which
+                        is ftell(codefile) right after open_codeword_reader
+                size_t index - index of the first codeword to read, counting
+                        row by row from the top-left block
+                uint32_t *codewords - array of length codewords, these
+                        values will be set
+                unsigned length - number of codewords to read
+
+        Returns: int - 0, EBADMSG if the file ends early, or EIO or the
+                errno of a failure to read it
 */
-Seq_T read_codewords (FILE *codefile, unsigned *width, unsigned *height);
+int read_codewords_at (FILE *codefile, long start, size_t index, 
+        uint32_t *codewords, unsigned length);
 
-#endif
\ No newline at end of file
+#endif
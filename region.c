@@ -0,0 +1,293 @@
+/*
+   region.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Functions for decompressing just part of a compressed image, or
+       a smaller version of it. Every block of a format 2 file is one 4-byte
+       codeword, stored row by row, so the codewords covering any rectangle
+       can be found without reading the rest of the file. Format 3 files
+       are split into tiles of whole rows that decode on their own, so only
+       the tiles covering the rectangle are read and decoded.
+*/
+#include "region.h"
+
+#include <stdint.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include "codewords.h"
+#include "readwrite.h"
+#include "fused.h"
+#include "fixed.h"
+#include "options.h"
+#include "context.h"
+
+#define COMPRESS_BLOCK_SIZE 2
+
+/* Same denominator decompress40 writes */
+#define RGB_DENOMINATOR 255
+
+/* decode_block_row
+    Purpose: Decompress a run of codewords from one row of blocks into two
+        scanlines, with the double-precision or fixed-point kernels.
+
+    Parameters:
+        int fixed_point - whether to use the kernels in fixed.c
+        uint32_t *codewords - array of length codewords
+        unsigned length - number of codewords (and blocks)
+        unsigned char *top - upper scanline of 6 * length bytes, these
+            values will be set
+        unsigned char *bottom - lower scanline of 6 * length bytes, these
+            values will be set
+*/
+static void decode_block_row (int fixed_point, uint32_t *codewords, 
+    unsigned length, unsigned char *top, unsigned char *bottom)
+{
+    if (fixed_point) {
+        decompress_rows_fixed(codewords, length, packingscheme,
+            RGB_DENOMINATOR, top, bottom);
+    } else {
+        decompress_rows(codewords, length, packingscheme, RGB_DENOMINATOR,
+            top, bottom);
+    }
+}
+
+/* decompress_region
+    Purpose: Decompress only a rectangle of a compressed image and write it
+        to output as a PPM, with a context's kernels and arena. The
+        rectangle is clipped to the image. Only the codewords of the blocks
+        that cover the rectangle are read, using pread, when the input is a
+        regular file; other streams are read in order up to the last row
+        that is needed.
+
+    Parameters:
+        Codec40 codec - context to use
+        FILE *input - stream to read codewords from
+        FILE *output - stream to write the PPM to
+        unsigned x - column of the rectangle's left edge, in pixels
+        unsigned y - row of the rectangle's top edge, in pixels
+        unsigned width - width of the rectangle, in pixels
+        unsigned height - height of the rectangle, in pixels
+
+    Returns: int - 0, EINVAL if any argument is NULL, if the input is not
+        a compressed image or if the rectangle is empty or starts outside
+        the image, EBADMSG or the error from the reader if the input is
+        malformed or ends early, or the error from finish_output if the
+        output cannot be written
+*/
+int decompress_region (Codec40 codec, FILE *input, FILE *output, 
+    unsigned x, unsigned y, unsigned width, unsigned height)
+{
+    if (codec == NULL || input == NULL || output == NULL) {
+        return EINVAL;
+    }
+
+    Arena_T arena = workspace_arena(&codec->workspace);
+    Codeword_Reader reader = open_codeword_reader(input, packingscheme, 
+        arena);
+    if (reader == NULL) {
+        return errno;
+    }
+
+    unsigned block_width = reader->width;
+    unsigned image_width = block_width * COMPRESS_BLOCK_SIZE;
+    unsigned image_height = reader->height * COMPRESS_BLOCK_SIZE;
+
+    if (width == 0 || height == 0 || x >= image_width || 
+        y >= image_height) {
+        free_codeword_reader(&reader);
+        return EINVAL;
+    }
+
+    if (width > image_width - x) {
+        width = image_width - x;
+    }
+    if (height > image_height - y) {
+        height = image_height - y;
+    }
+
+    /* blocks that cover the rectangle */
+    unsigned first_col = x / COMPRESS_BLOCK_SIZE;
+    unsigned last_col = (x + width - 1) / COMPRESS_BLOCK_SIZE;
+    unsigned first_row = y / COMPRESS_BLOCK_SIZE;
+    unsigned last_row = (y + height - 1) / COMPRESS_BLOCK_SIZE;
+    unsigned blocks = last_col - first_col + 1;
+
+    /* where the rectangle starts in the decoded scanlines */
+    size_t left = (size_t) 3 * (x - first_col * COMPRESS_BLOCK_SIZE);
+    size_t stride = (size_t) 3 * COMPRESS_BLOCK_SIZE * blocks;
+
+    int tiled = reader->format == TILED_FORMAT;
+
+    struct stat info;
+    long start = ftell(input);
+    int seekable = !tiled && start >= 0 && 
+        fstat(fileno(input), &info) == 0 && S_ISREG(info.st_mode);
+
+    /* a whole row of codewords is only needed when reading in order, and a
+        whole tile when reading tiles */
+    size_t length = seekable ? blocks : block_width;
+    if (tiled) {
+        length = (size_t) reader->tile_rows * block_width;
+    }
+
+    uint32_t *codewords = Arena_alloc(arena, 
+        (length + 1) * sizeof(*codewords));
+    unsigned char *scanlines = Arena_alloc(arena, 
+        COMPRESS_BLOCK_SIZE * stride + 1);
+
+    Ppm_Writer writer = open_ppm_writer(output, width, height, 
+        RGB_DENOMINATOR, arena);
+
+    unsigned tile = reader->ntiles;     /* tile in codewords, if any */
+
+    int error = 0;
+    unsigned row;
+    for (row = seekable || tiled ? first_row : 0; row <= last_row; row++) {
+        uint32_t *run = codewords;
+
+        if (tiled) {
+            if (tile != row / reader->tile_rows) {
+                tile = row / reader->tile_rows;
+                error = read_codeword_tile(reader, tile, codewords);
+            }
+
+            run = &codewords[(size_t) (row % reader->tile_rows) * 
+                block_width + first_col];
+        } else if (seekable) {
+            error = read_codewords_at(input, start, 
+                (size_t) row * block_width + first_col, codewords, blocks);
+        } else {
+            error = read_codeword_rows(reader, codewords, 1);
+            run = &codewords[first_col];
+        }
+
+        if (error != 0) {
+            break;
+        }
+        if (!tiled && !seekable && row < first_row) {
+            continue;
+        }
+
+        decode_block_row(codec->options.fixed_point, run, blocks, 
+            scanlines, &scanlines[stride]);
+
+        /* the rectangle may start or end halfway through a block */
+        unsigned line;
+        for (line = 0; line < COMPRESS_BLOCK_SIZE; line++) {
+            unsigned pixel_row = row * COMPRESS_BLOCK_SIZE + line;
+
+            if (pixel_row >= y && pixel_row < y + height) {
+                write_ppm_bytes(writer, &scanlines[line * stride + left]);
+            }
+        }
+    }
+
+    free_ppm_writer(&writer);
+    free_codeword_reader(&reader);
+
+    if (error != 0) {
+        return error;
+    }
+
+    return finish_output(output);
+}
+
+/* decompress40_region
+    Purpose: Decompress only a rectangle of a compressed image and write it
+        to stdout, with the options in compress40_options. See
+        decompress_region for more info.
+
+    Parameters:
+        FILE *input - stream to read codewords from
+        unsigned x - column of the rectangle's left edge, in pixels
+        unsigned y - row of the rectangle's top edge, in pixels
+        unsigned width - width of the rectangle, in pixels
+        unsigned height - height of the rectangle, in pixels
+
+    Errors: Throws an error if input is NULL, if the rectangle is empty or
+        starts outside the image, if the input is malformed or ends early or
+        if the output cannot be written.
+*/
+void decompress40_region (FILE *input, unsigned x, unsigned y, 
+    unsigned width, unsigned height)
+{
+    int error = decompress_region(compress40_codec(), input, stdout, x, y,
+        width, height);
+    assert(error == 0);
+}
+
+/* decompress_thumbnail
+    Purpose: Decompress a compressed image at half its width and height and
+        write it to output as a PPM, with a context's arena. Each block
+        becomes one pixel, made from the block's average luminance and
+        chroma, without an inverse DCT.
+
+    Parameters:
+        Codec40 codec - context to use
+        FILE *input - stream to read codewords from
+        FILE *output - stream to write the PPM to
+
+    Returns: int - 0, EINVAL if any argument is NULL or if the input is not
+        a compressed image, EBADMSG or the error from the reader if the
+        input is malformed or ends early, or the error from finish_output
+        if the output cannot be written
+*/
+int decompress_thumbnail (Codec40 codec, FILE *input, FILE *output)
+{
+    if (codec == NULL || input == NULL || output == NULL) {
+        return EINVAL;
+    }
+
+    Arena_T arena = workspace_arena(&codec->workspace);
+    Codeword_Reader reader = open_codeword_reader(input, packingscheme, 
+        arena);
+    if (reader == NULL) {
+        return errno;
+    }
+
+    unsigned block_width = reader->width;
+    unsigned block_height = reader->height;
+
+    uint32_t *codewords = Arena_alloc(arena, ((size_t) block_width + 1) * 
+        sizeof(*codewords));
+
+    Ppm_Writer writer = open_ppm_writer(output, block_width, block_height,
+        RGB_DENOMINATOR, arena);
+
+    int error = 0;
+    unsigned row;
+    for (row = 0; row < block_height && error == 0; row++) {
+        error = read_codeword_rows(reader, codewords, 1);
+        if (error == 0) {
+            decompress_thumbnail_row(codewords, block_width, packingscheme,
+                RGB_DENOMINATOR, next_ppm_rows(writer, 1));
+        }
+    }
+
+    free_ppm_writer(&writer);
+    free_codeword_reader(&reader);
+
+    if (error != 0) {
+        return error;
+    }
+
+    return finish_output(output);
+}
+
+/* decompress40_thumbnail
+    Purpose: Decompress a compressed image at half its width and height and
+        write it to stdout, with the options in compress40_options. See
+        decompress_thumbnail for more info.
+
+    Parameters: FILE *input - stream to read codewords from
+
+    Errors: Throws an error if input is NULL, if the input is malformed or
+        ends early or if the output cannot be written.
+*/
+void decompress40_thumbnail (FILE *input)
+{
+    int error = decompress_thumbnail(compress40_codec(), input, stdout);
+    assert(error == 0);
+}
\ No newline at end of file
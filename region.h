@@ -0,0 +1,47 @@
+/*
+   region.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for decompressing just part of a compressed image, or
+       a smaller version of it.
+*/
+#ifndef REGION_INCLUDED
+#define REGION_INCLUDED
+
+#include <stdio.h>
+
+/* decompress40_region
+    Purpose: Decompress only a rectangle of a compressed image and write it
+        to stdout as a PPM. The rectangle is clipped to the image. Only the
+        codewords of the blocks that cover the rectangle are read, using
+        pread, when the input is a regular format 2 file; other format 2
+        streams are read in order up to the last row that is needed. Only
+        the tiles that cover the rectangle of a format 3 image are decoded.
+
+    Parameters:
+        FILE *input - stream to read codewords from
+        unsigned x - column of the rectangle's left edge, in pixels
+        unsigned y - row of the rectangle's top edge, in pixels
+        unsigned width - width of the rectangle, in pixels
+        unsigned height - height of the rectangle, in pixels
+
+    Errors: Throws an error if input is NULL, if the rectangle is empty or
+        starts outside the image, if the input ends early or if the output
+        cannot be written.
+*/
+void decompress40_region (FILE *input, unsigned x, unsigned y, 
+        unsigned width, unsigned height);
+
+/* decompress40_thumbnail
+    Purpose: Decompress a compressed image at half its width and height and
+        write it to stdout as a PPM. Each block becomes one pixel, made from
+        the block's average luminance and chroma, without an inverse DCT.
+
+    Parameters: FILE *input - stream to read codewords from
+
+    Errors: Throws an error if input is NULL, if the input ends early or if
+        the output cannot be written.
+*/
+void decompress40_thumbnail (FILE *input);
+
+#endif
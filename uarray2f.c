@@ -0,0 +1,120 @@
+/*
+   uarray2f.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Implementation of a flat 2D unboxed array, stored in a single
+       cache-line aligned allocation.
+*/
+#include "uarray2f.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define T UArray2f_T
+
+/* Rows start on cache lines this many bytes apart */
+#define ROW_ALIGNMENT 64
+
+/* UArray2f_new
+    Purpose: Create a 2D array whose elements are all in one allocation.
+
+    Parameters: See uarray2f.h for more info.
+*/
+T UArray2f_new (int width, int height, int size)
+{
+    assert(width >= 0 && height >= 0 && size > 0);
+
+    T array2 = malloc(sizeof(*array2));
+    assert(array2 != NULL);
+
+    array2->width = width;
+    array2->height = height;
+    array2->size = size;
+    array2->stride = ((size_t) width * size + ROW_ALIGNMENT - 1) / 
+        ROW_ALIGNMENT * ROW_ALIGNMENT;
+
+    assert(height == 0 || array2->stride <= SIZE_MAX / height);
+    size_t bytes = array2->stride * height;
+
+    void *elements;
+    int made = posix_memalign(&elements, ROW_ALIGNMENT, 
+        bytes == 0 ? ROW_ALIGNMENT : bytes) == 0;
+    assert(made);
+
+    array2->elements = elements;
+
+    return array2;
+}
+
+/* UArray2f_free
+    Purpose: Free a 2D array and its elements.
+
+    Parameters: See uarray2f.h for more info.
+*/
+void UArray2f_free (T *array2)
+{
+    assert(array2 != NULL && *array2 != NULL);
+
+    free((*array2)->elements);
+    free(*array2);
+    *array2 = NULL;
+}
+
+int UArray2f_width (T array2)
+{
+    assert(array2 != NULL);
+    return array2->width;
+}
+
+int UArray2f_height (T array2)
+{
+    assert(array2 != NULL);
+    return array2->height;
+}
+
+int UArray2f_size (T array2)
+{
+    assert(array2 != NULL);
+    return array2->size;
+}
+
+/* UArray2f_map_row_major
+    Purpose: Call apply for every element, a row at a time. Each row is
+        walked with a pointer instead of looking up every element.
+
+    Parameters: See uarray2f.h for more info.
+*/
+void UArray2f_map_row_major (T array2, UArray2f_applyfun apply, void *cl)
+{
+    assert(array2 != NULL && apply != NULL);
+
+    int i, j;
+    for (j = 0; j < array2->height; j++) {
+        char *elem = array2->elements + (size_t) j * array2->stride;
+
+        for (i = 0; i < array2->width; i++) {
+            apply(i, j, array2, elem, cl);
+            elem += array2->size;
+        }
+    }
+}
+
+/* UArray2f_map_col_major
+    Purpose: Call apply for every element, a column at a time.
+
+    Parameters: See uarray2f.h for more info.
+*/
+void UArray2f_map_col_major (T array2, UArray2f_applyfun apply, void *cl)
+{
+    assert(array2 != NULL && apply != NULL);
+
+    int i, j;
+    for (i = 0; i < array2->width; i++) {
+        char *elem = array2->elements + (size_t) i * array2->size;
+
+        for (j = 0; j < array2->height; j++) {
+            apply(i, j, array2, elem, cl);
+            elem += array2->stride;
+        }
+    }
+}
@@ -0,0 +1,117 @@
+/*
+   uarray2f.h
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Interface for a flat 2D unboxed array. Unlike UArray2_T, whose
+       rows are each their own UArray_T, all of its elements are in one
+       allocation, so an element's address is a multiply and an add away.
+*/
+#ifndef UARRAY2F_INCLUDED
+#define UARRAY2F_INCLUDED
+
+#include <stddef.h>
+#include <assert.h>
+
+#define T UArray2f_T
+typedef struct T *T;
+
+/* Elements are stored row by row. Each row takes stride bytes, a multiple
+    of 64, so that every row starts on its own cache line. The struct is
+    only public so that UArray2f_row and UArray2f_at can be inlined; use
+    the functions below instead of its fields. */
+struct T {
+    int width, height;
+    int size;
+    size_t stride;
+    char *elements;
+};
+
+/* UArray2f_applyfun is called for every element by the map functions */
+typedef void UArray2f_applyfun (int i, int j, T array2, void *elem, 
+    void *cl);
+
+/* UArray2f_new
+    Purpose: Create a 2D array whose elements are all in one allocation.
+        Its elements are not initialized.
+
+    Parameters:
+        int width - number of columns
+        int height - number of rows
+        int size - bytes in an element
+
+    Returns: UArray2f_T - new array
+
+    Errors: Throws an error if width or height is negative, if size is not
+        positive or if it cannot allocate memory.
+*/
+T UArray2f_new (int width, int height, int size);
+
+/* UArray2f_free
+    Purpose: Free a 2D array and its elements.
+
+    Parameters: UArray2f_T *array2 - pointer to array to free
+*/
+void UArray2f_free (T *array2);
+
+/* UArray2f_width, UArray2f_height, UArray2f_size
+    Purpose: Get the number of columns, the number of rows or the bytes in
+        an element of a 2D array.
+
+    Parameters: UArray2f_T array2 - array to ask about
+*/
+int UArray2f_width (T array2);
+int UArray2f_height (T array2);
+int UArray2f_size (T array2);
+
+/* UArray2f_row
+    Purpose: Get the first element of a row. The row's elements follow it
+        one after the other, so a whole row can be walked with a pointer.
+
+    Parameters:
+        UArray2f_T array2 - array to look in
+        int j - row
+
+    Returns: void * - address of element (0, j)
+
+    Errors: Throws an error if array2 is NULL or j is out of range.
+*/
+static inline void *UArray2f_row (T array2, int j)
+{
+    assert(array2 != NULL && j >= 0 && j < array2->height);
+
+    return array2->elements + (size_t) j * array2->stride;
+}
+
+/* UArray2f_at
+    Purpose: Get the address of an element.
+
+    Parameters:
+        UArray2f_T array2 - array to look in
+        int i - column
+        int j - row
+
+    Returns: void * - address of element (i, j)
+
+    Errors: Throws an error if array2 is NULL or i or j is out of range.
+*/
+static inline void *UArray2f_at (T array2, int i, int j)
+{
+    assert(array2 != NULL && i >= 0 && i < array2->width);
+
+    return (char *) UArray2f_row(array2, j) + (size_t) i * array2->size;
+}
+
+/* UArray2f_map_row_major, UArray2f_map_col_major
+    Purpose: Call apply for every element, going along each row in turn or
+        down each column in turn.
+
+    Parameters:
+        UArray2f_T array2 - array to map over
+        UArray2f_applyfun apply - function to call for every element
+        void *cl - closure passed to every call of apply
+*/
+void UArray2f_map_row_major (T array2, UArray2f_applyfun apply, void *cl);
+void UArray2f_map_col_major (T array2, UArray2f_applyfun apply, void *cl);
+
+#undef T
+#endif
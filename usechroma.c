@@ -0,0 +1,66 @@
+/*
+   usechroma.c
+   Written by Ronit Sinha (rsinha01) and Helena Benatar (hbenat01)
+   Date: 27 October 2021
+   Purpose: Checks the inline chroma quantizer in chroma.h against the
+       arith40 library for every float that is not NaN.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <arith40.h>
+
+#include "chroma.h"
+
+
+int main(int argc, char const *argv[])
+{
+        (void) argc;
+        (void) argv;
+
+        init_chroma_tables();
+
+        unsigned i;
+        unsigned long errors = 0;
+
+        printf("---DEQUANTIZE TEST----\n");
+        for (i = 0; i < CHROMA_LEVELS; i++) {
+                float expected = Arith40_chroma_of_index(i);
+                float actual = index_to_chroma(i);
+
+                printf("%2u -> %+.6f (threshold %+.9g) %s\n", i, actual,
+                        i > 0 ? chroma_thresholds[i - 1] : -INFINITY,
+                        memcmp(&expected, &actual, sizeof(float)) == 0 ?
+                        "OK" : "WRONG");
+                errors += memcmp(&expected, &actual, sizeof(float)) != 0;
+        }
+
+        printf("---QUANTIZE TEST----\n");
+        uint64_t bits;
+        uint64_t checked = 0;
+        for (bits = 0; bits <= UINT32_MAX; bits++) {
+                uint32_t pattern = bits;
+                float x;
+                memcpy(&x, &pattern, sizeof(x));
+                if (isnan(x)) {
+                        continue;
+                }
+
+                unsigned expected = Arith40_index_of_chroma(x);
+                unsigned actual = chroma_to_index(x);
+                if (expected != actual) {
+                        if (errors < 10) {
+                                printf("%+.9g: arith40 says %u, chroma.h "
+                                        "says %u\n", x, expected, actual);
+                        }
+                        errors++;
+                }
+                checked++;
+        }
+
+        printf("Checked %lu floats, %lu errors\n", (unsigned long) checked,
+                errors);
+
+        return errors == 0 ? 0 : 1;
+}